@@ -154,12 +154,13 @@ if(glslang_FOUND AND NOT TARGET glslang::glslang)
         glslang::OGLCompiler
         glslang::HLSL
     )
-    if (SPIRV-Tools_LIBRARY)
-        list(APPEND GLSLANG glslang::SPIRV-Tools)
-    endif()
-
+    # SPIRV-Tools-opt depends on SPIRV-Tools so must come first when linking static libraries
     if (SPIRV-Tools-opt_LIBRARY)
         list(APPEND GLSLANG glslang::SPIRV-Tools-opt)
     endif()
+
+    if (SPIRV-Tools_LIBRARY)
+        list(APPEND GLSLANG glslang::SPIRV-Tools)
+    endif()
 endif()
 
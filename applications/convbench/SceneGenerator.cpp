@@ -0,0 +1,235 @@
+#include "SceneGenerator.h"
+
+#include <osg/Billboard>
+#include <osg/BlendFunc>
+#include <osg/Geometry>
+#include <osg/LOD>
+#include <osg/Material>
+#include <osg/MatrixTransform>
+#include <osg/PagedLOD>
+#include <osg/Texture2D>
+
+#include <cfloat>
+#include <cmath>
+#include <random>
+
+using namespace osg2vsg;
+
+namespace
+{
+    // grid of gridSize x gridSize quads of width 1 centred on position, with a ripple so the normals and tangents vary
+    osg::ref_ptr<osg::Geometry> createGrid(uint32_t gridSize, const osg::Vec3& position)
+    {
+        gridSize = std::max(1u, gridSize);
+        uint32_t numColumns = gridSize + 1;
+
+        osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+        osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
+        osg::ref_ptr<osg::Vec2Array> texcoords = new osg::Vec2Array;
+        for(uint32_t r = 0; r < numColumns; ++r)
+        {
+            for(uint32_t c = 0; c < numColumns; ++c)
+            {
+                float s = static_cast<float>(c) / static_cast<float>(gridSize);
+                float t = static_cast<float>(r) / static_cast<float>(gridSize);
+                float z = 0.05f * std::sin(s * 6.2832f) * std::cos(t * 6.2832f);
+                vertices->push_back(position + osg::Vec3(s - 0.5f, t - 0.5f, z));
+
+                osg::Vec3 normal(-0.3142f * std::cos(s * 6.2832f) * std::cos(t * 6.2832f), 0.3142f * std::sin(s * 6.2832f) * std::sin(t * 6.2832f), 1.0f);
+                normal.normalize();
+                normals->push_back(normal);
+                texcoords->push_back(osg::Vec2(s, t));
+            }
+        }
+
+        osg::ref_ptr<osg::DrawElements> indices;
+        if (vertices->size() <= 65536) indices = new osg::DrawElementsUShort(GL_TRIANGLES);
+        else indices = new osg::DrawElementsUInt(GL_TRIANGLES);
+        for(uint32_t r = 0; r < gridSize; ++r)
+        {
+            for(uint32_t c = 0; c < gridSize; ++c)
+            {
+                uint32_t i = r * numColumns + c;
+                indices->addElement(i);
+                indices->addElement(i + 1);
+                indices->addElement(i + numColumns);
+                indices->addElement(i + 1);
+                indices->addElement(i + numColumns + 1);
+                indices->addElement(i + numColumns);
+            }
+        }
+
+        osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+        geometry->setVertexArray(vertices);
+        geometry->setNormalArray(normals, osg::Array::BIND_PER_VERTEX);
+        geometry->setTexCoordArray(0, texcoords, osg::Array::BIND_PER_VERTEX);
+        geometry->addPrimitiveSet(indices);
+        return geometry;
+    }
+
+    // checker board in the colour, the DXT1 blocks are the colour and black selected by alternating indices
+    osg::ref_ptr<osg::Image> createImage(uint32_t size, TextureFormat format, const osg::Vec4& color)
+    {
+        size = std::max(4u, size);
+        osg::ref_ptr<osg::Image> image = new osg::Image;
+
+        if (format == TextureFormat::DXT1)
+        {
+            uint32_t numBlocks = (size / 4) * (size / 4);
+            unsigned char* data = new unsigned char[numBlocks * 8];
+
+            uint16_t color0 = static_cast<uint16_t>((static_cast<uint16_t>(color.r() * 31.0f) << 11) | (static_cast<uint16_t>(color.g() * 63.0f) << 5) | static_cast<uint16_t>(color.b() * 31.0f));
+            for(uint32_t b = 0; b < numBlocks; ++b)
+            {
+                unsigned char* block = data + b * 8;
+                block[0] = static_cast<unsigned char>(color0 & 0xff);
+                block[1] = static_cast<unsigned char>(color0 >> 8);
+                block[2] = 0;
+                block[3] = 0;
+                for(int i = 4; i < 8; ++i) block[i] = (i % 2 == 0) ? 0x44 : 0x11;
+            }
+
+            image->setImage(size, size, 1, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_UNSIGNED_BYTE, data, osg::Image::USE_NEW_DELETE);
+            return image;
+        }
+
+        GLenum pixelFormat = (format == TextureFormat::RGB) ? GL_RGB : GL_RGBA;
+        uint32_t numComponents = (format == TextureFormat::RGB) ? 3 : 4;
+        image->allocateImage(size, size, 1, pixelFormat, GL_UNSIGNED_BYTE);
+
+        for(uint32_t t = 0; t < size; ++t)
+        {
+            unsigned char* pixel = image->data(0, t);
+            for(uint32_t s = 0; s < size; ++s)
+            {
+                float scale = (((s / 8) + (t / 8)) % 2 == 0) ? 1.0f : 0.25f;
+                for(uint32_t i = 0; i < numComponents; ++i) *(pixel++) = static_cast<unsigned char>((i < 3 ? color[i] * scale : 1.0f) * 255.0f);
+            }
+        }
+        return image;
+    }
+
+    osg::ref_ptr<osg::Node> createLOD(const SceneParameters& parameters, const osg::Vec3& position)
+    {
+        osg::ref_ptr<osg::LOD> lod;
+        if (parameters.pagedLOD) lod = new osg::PagedLOD;
+        else lod = new osg::LOD;
+
+        // each level halves the grid size and is used over the next band of distances
+        const float range = 20.0f;
+        for(uint32_t level = 0; level < parameters.lodLevels; ++level)
+        {
+            float maxRange = (level + 1 == parameters.lodLevels) ? FLT_MAX : range * static_cast<float>(level + 1);
+            lod->addChild(createGrid(parameters.gridSize >> level, position), range * static_cast<float>(level), maxRange);
+        }
+        return lod;
+    }
+}
+
+bool osg2vsg::parseTextureFormat(const std::string& str, TextureFormat& format)
+{
+    if (str == "rgba") format = TextureFormat::RGBA;
+    else if (str == "rgb") format = TextureFormat::RGB;
+    else if (str == "dxt1") format = TextureFormat::DXT1;
+    else return false;
+    return true;
+}
+
+osg::ref_ptr<osg::Node> osg2vsg::generateScene(const SceneParameters& parameters)
+{
+    std::mt19937 random(parameters.seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    std::vector<osg::ref_ptr<osg::Texture2D>> textures;
+    for(uint32_t i = 0; i < parameters.numTextures; ++i)
+    {
+        osg::Vec4 color(unit(random), unit(random), unit(random), 1.0f);
+
+        osg::ref_ptr<osg::Texture2D> texture = new osg::Texture2D(createImage(parameters.textureSize, parameters.textureFormat, color));
+        texture->setWrap(osg::Texture::WRAP_S, osg::Texture::REPEAT);
+        texture->setWrap(osg::Texture::WRAP_T, osg::Texture::REPEAT);
+        textures.push_back(texture);
+    }
+
+    // every eighth stateset is blended so the scene has both opaque and transparent pipelines
+    std::vector<osg::ref_ptr<osg::StateSet>> statesets;
+    for(uint32_t i = 0; i < std::max(1u, parameters.numStateSets); ++i)
+    {
+        osg::ref_ptr<osg::StateSet> stateset = new osg::StateSet;
+
+        osg::ref_ptr<osg::Material> material = new osg::Material;
+        material->setDiffuse(osg::Material::FRONT_AND_BACK, osg::Vec4(unit(random), unit(random), unit(random), (i % 8 == 7) ? 0.5f : 1.0f));
+        stateset->setAttributeAndModes(material);
+
+        if (!textures.empty()) stateset->setTextureAttributeAndModes(0, textures[i % textures.size()]);
+
+        if (i % 8 == 7)
+        {
+            stateset->setAttributeAndModes(new osg::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+            stateset->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
+        }
+
+        statesets.push_back(stateset);
+    }
+
+    // the geometries are split into roughly square clusters laid out on a grid, each below its own chain of transforms
+    uint32_t numClusters = std::max(1u, static_cast<uint32_t>(std::sqrt(static_cast<double>(parameters.numGeometries))));
+    uint32_t clustersPerRow = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(numClusters)))));
+    const float spacing = 2.0f;
+
+    osg::ref_ptr<osg::Group> root = new osg::Group;
+    for(uint32_t cluster = 0; cluster < numClusters; ++cluster)
+    {
+        uint32_t begin = cluster * parameters.numGeometries / numClusters;
+        uint32_t end = (cluster + 1) * parameters.numGeometries / numClusters;
+        uint32_t clusterSize = end - begin;
+        uint32_t geometriesPerRow = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(clusterSize)))));
+        float clusterWidth = spacing * static_cast<float>(geometriesPerRow + 1);
+
+        osg::ref_ptr<osg::Group> parent = root;
+        for(uint32_t depth = 0; depth < parameters.transformDepth; ++depth)
+        {
+            osg::ref_ptr<osg::MatrixTransform> transform = new osg::MatrixTransform;
+            if (depth == 0) transform->setMatrix(osg::Matrix::translate(static_cast<float>(cluster % clustersPerRow) * clusterWidth, static_cast<float>(cluster / clustersPerRow) * clusterWidth, 0.0f));
+            else transform->setMatrix(osg::Matrix::rotate(osg::DegreesToRadians(unit(random) * 10.0f), osg::Vec3(0.0f, 0.0f, 1.0f)));
+
+            parent->addChild(transform);
+            parent = transform;
+        }
+
+        osg::ref_ptr<osg::Billboard> billboard;
+        for(uint32_t i = begin; i < end; ++i)
+        {
+            uint32_t index = i - begin;
+            osg::Vec3 position(spacing * static_cast<float>(index % geometriesPerRow), spacing * static_cast<float>(index / geometriesPerRow), 0.0f);
+            auto& stateset = statesets[i % statesets.size()];
+
+            if (unit(random) < parameters.billboardFraction)
+            {
+                if (!billboard)
+                {
+                    billboard = new osg::Billboard;
+                    parent->addChild(billboard);
+                }
+
+                auto geometry = createGrid(parameters.gridSize, osg::Vec3());
+                geometry->setStateSet(stateset);
+                billboard->addDrawable(geometry, position);
+            }
+            else if (parameters.lodLevels > 0)
+            {
+                auto lod = createLOD(parameters, position);
+                lod->setStateSet(stateset);
+                parent->addChild(lod);
+            }
+            else
+            {
+                auto geometry = createGrid(parameters.gridSize, position);
+                geometry->setStateSet(stateset);
+                parent->addChild(geometry);
+            }
+        }
+    }
+
+    return root;
+}
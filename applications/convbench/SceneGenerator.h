@@ -0,0 +1,35 @@
+#pragma once
+
+#include <osg/Node>
+
+#include <string>
+
+namespace osg2vsg
+{
+    enum class TextureFormat
+    {
+        RGBA,
+        RGB, // converted to RGBA by osg2vsg
+        DXT1 // block compressed, copied as is
+    };
+
+    // parameters of a procedurally generated scene, the same parameters and seed always generate the same scene
+    struct SceneParameters
+    {
+        uint32_t numGeometries = 1000;
+        uint32_t gridSize = 8; // each geometry is a grid of gridSize x gridSize quads
+        uint32_t numStateSets = 16; // distinct combinations of material, texture and blending
+        uint32_t numTextures = 8;
+        uint32_t textureSize = 256;
+        TextureFormat textureFormat = TextureFormat::RGBA;
+        uint32_t transformDepth = 2; // nested MatrixTransforms above each cluster of geometries
+        double billboardFraction = 0.0; // fraction of the geometries placed in osg::Billboards
+        uint32_t lodLevels = 0; // when non zero each geometry is replaced by an osg::LOD with this many levels of detail
+        bool pagedLOD = false; // use osg::PagedLOD with the children already loaded in place of osg::LOD
+        uint32_t seed = 1;
+    };
+
+    osg::ref_ptr<osg::Node> generateScene(const SceneParameters& parameters);
+
+    bool parseTextureFormat(const std::string& str, TextureFormat& format);
+}
@@ -0,0 +1,211 @@
+#include <vsg/all.h>
+
+#include <osgDB/WriteFile>
+
+#include <osg2vsg/BenchmarkUtils.h>
+#include <osg2vsg/SceneBuilder.h>
+
+#include "ConvertToVsg.h"
+#include "SceneGenerator.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    struct SweepPoint
+    {
+        std::string value;
+        osg2vsg::SceneParameters parameters;
+        osg2vsg::SceneSize sceneSize;
+        osg2vsg::TimingSummary sceneBuilder;
+        osg2vsg::TimingSummary convertToVsg;
+    };
+
+    // set the parameter named on the command line, returns false if the name isn't recognised
+    bool setParameter(osg2vsg::SceneParameters& parameters, const std::string& name, double value)
+    {
+        uint32_t count = static_cast<uint32_t>(value);
+        if (name == "geometries") parameters.numGeometries = count;
+        else if (name == "grid") parameters.gridSize = count;
+        else if (name == "statesets") parameters.numStateSets = count;
+        else if (name == "textures") parameters.numTextures = count;
+        else if (name == "texture-size") parameters.textureSize = count;
+        else if (name == "depth") parameters.transformDepth = count;
+        else if (name == "billboards") parameters.billboardFraction = value;
+        else if (name == "lods") parameters.lodLevels = count;
+        else return false;
+        return true;
+    }
+
+    template<typename Func>
+    double timeMilliseconds(Func func)
+    {
+        auto before = std::chrono::steady_clock::now();
+        func();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - before).count();
+    }
+
+    double perSecond(uint64_t amount, const osg2vsg::TimingSummary& summary)
+    {
+        return summary.median > 0.0 ? static_cast<double>(amount) * 1000.0 / summary.median : 0.0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    vsg::CommandLine arguments(&argc, argv);
+
+    auto buildOptions = osg2vsg::BuildOptions::create();
+    arguments.read({"--threads", "--nt"}, buildOptions->numThreads);
+    if (arguments.read("--bindless")) buildOptions->bindlessTextures = true;
+    {
+        // limits of the device the scene will be rendered on, --bindless falls back to a binding per texture unit when they are exceeded
+        auto& pipelineCache = buildOptions->pipelineCache;
+        auto& deviceLimits = pipelineCache->deviceLimits;
+        if (arguments.read("--device-limits") && !osg2vsg::queryDeviceLimits(deviceLimits)) std::cout<<"No Vulkan device found, using the guaranteed device limits."<<std::endl;
+        arguments.read("--max-push-constants", deviceLimits.maxPushConstantsSize);
+        if (uint32_t maxSamplers = 0; arguments.read("--max-samplers", maxSamplers))
+        {
+            deviceLimits.maxPerStageDescriptorSamplers = deviceLimits.maxPerStageDescriptorSampledImages = maxSamplers;
+            deviceLimits.maxDescriptorSetSamplers = deviceLimits.maxDescriptorSetSampledImages = maxSamplers;
+        }
+        if (arguments.read("--dynamic-indexing")) deviceLimits.sampledImageArrayDynamicIndexing = true;
+        arguments.read("--max-bindless-textures", pipelineCache->maxBindlessTextures);
+        if (buildOptions->bindlessTextures && !pipelineCache->supportsBindlessTextures())
+        {
+            std::cout<<"--bindless requires --dynamic-indexing, 152 bytes of push constants and --max-bindless-textures within the sampler limits, using a binding per texture unit."<<std::endl;
+        }
+    }
+
+    osg2vsg::SceneParameters parameters;
+    arguments.read("--geometries", parameters.numGeometries);
+    arguments.read("--grid", parameters.gridSize);
+    arguments.read("--statesets", parameters.numStateSets);
+    arguments.read("--textures", parameters.numTextures);
+    arguments.read("--texture-size", parameters.textureSize);
+    arguments.read("--depth", parameters.transformDepth);
+    arguments.read("--billboards", parameters.billboardFraction);
+    arguments.read("--lods", parameters.lodLevels);
+    if (arguments.read("--paged")) parameters.pagedLOD = true;
+    arguments.read("--seed", parameters.seed);
+
+    if (std::string format; arguments.read("--texture-format", format) && !osg2vsg::parseTextureFormat(format, parameters.textureFormat))
+    {
+        std::cout<<"Unsupported texture format "<<format<<", use rgba, rgb or dxt1."<<std::endl;
+        return 1;
+    }
+
+    // the parameter that is varied and the comma separated values it takes, the other parameters are kept fixed
+    std::string sweepName("geometries");
+    std::string sweepValues("100,1000,10000");
+    arguments.read("--sweep", sweepName, sweepValues);
+
+    auto iterations = arguments.value(5u, "-n");
+    auto jsonFilename = arguments.value(std::string(), "--json");
+    auto sceneFilename = arguments.value(std::string(), "--write");
+
+    if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
+
+    std::vector<SweepPoint> sweepPoints;
+    std::istringstream valueStream(sweepValues);
+    for(std::string value; std::getline(valueStream, value, ',');)
+    {
+        SweepPoint point;
+        point.value = value;
+        point.parameters = parameters;
+        if (!setParameter(point.parameters, sweepName, std::atof(value.c_str())))
+        {
+            std::cout<<"Unsupported sweep parameter "<<sweepName<<", use geometries, grid, statesets, textures, texture-size, depth, billboards or lods."<<std::endl;
+            return 1;
+        }
+        sweepPoints.push_back(point);
+    }
+
+    if (sweepPoints.empty())
+    {
+        std::cout<<"No sweep values."<<std::endl;
+        return 1;
+    }
+
+    if (!sceneFilename.empty())
+    {
+        osgDB::writeNodeFile(*osg2vsg::generateScene(sweepPoints.back().parameters), sceneFilename);
+    }
+
+    vsg::Paths searchPaths;
+    for(auto& point : sweepPoints)
+    {
+        std::vector<double> sceneBuilderTimes;
+        std::vector<double> convertToVsgTimes;
+
+        // the conversions modify the osg scene so each one is given a freshly generated scene, the generation isn't timed.
+        // The pipelineCache is shared between the iterations, so only the first iteration of the first point includes compiling the shaders.
+        for(uint32_t iteration = 0; iteration < iterations; ++iteration)
+        {
+            auto osg_scene = osg2vsg::generateScene(point.parameters);
+            if (iteration == 0) point.sceneSize = osg2vsg::computeSceneSize(*osg_scene);
+
+            sceneBuilderTimes.push_back(timeMilliseconds([&]() {
+                osg2vsg::SceneBuilder sceneBuilder(buildOptions);
+                sceneBuilder.traverseInParallel(*osg_scene);
+                sceneBuilder.createVSG(searchPaths);
+            }));
+
+            osg_scene = osg2vsg::generateScene(point.parameters);
+
+            convertToVsgTimes.push_back(timeMilliseconds([&]() {
+                osg2vsg::ConvertToVsg convertToVsg(buildOptions, 0, 1, 0);
+
+                osg2vsg::SceneBuilderBase::Textures textures;
+                convertToVsg.collectTextures(osg_scene, textures);
+                convertToVsg.convertTextures(textures);
+                if (buildOptions->bindlessTextures && buildOptions->pipelineCache->supportsBindlessTextures()) convertToVsg.assignTextureIndices(textures);
+
+                convertToVsg.convert(osg_scene);
+            }));
+        }
+
+        point.sceneBuilder = osg2vsg::summarizeTimings(sceneBuilderTimes);
+        point.convertToVsg = osg2vsg::summarizeTimings(convertToVsgTimes);
+    }
+
+    std::cout<<"Sweep of "<<sweepName<<", "<<iterations<<" iterations per point, "<<buildOptions->numThreads<<" threads\n";
+    std::cout<<"    "<<sweepName<<"\tGeometries\tTriangles\tTexels\tSceneBuilder median ms\tP95 ms\tTriangles/s\tConvertToVsg median ms\tP95 ms\tTriangles/s\n";
+    for(auto& point : sweepPoints)
+    {
+        auto& size = point.sceneSize;
+        std::cout<<"    "<<point.value<<"\t"<<size.geometries<<"\t"<<size.triangles<<"\t"<<size.texels
+                 <<"\t"<<point.sceneBuilder.median<<"\t"<<point.sceneBuilder.p95<<"\t"<<perSecond(size.triangles, point.sceneBuilder)
+                 <<"\t"<<point.convertToVsg.median<<"\t"<<point.convertToVsg.p95<<"\t"<<perSecond(size.triangles, point.convertToVsg)<<"\n";
+    }
+    std::cout<<"Peak RSS "<<osg2vsg::getPeakResidentSetSize()<<" bytes"<<std::endl;
+
+    if (!jsonFilename.empty())
+    {
+        std::ofstream fout(jsonFilename);
+        fout<<"{\n";
+        fout<<"  \"sweep\": \""<<sweepName<<"\",\n";
+        fout<<"  \"iterations\": "<<iterations<<",\n";
+        fout<<"  \"threads\": "<<buildOptions->numThreads<<",\n";
+        fout<<"  \"points\": [";
+        for(auto& point : sweepPoints)
+        {
+            auto& size = point.sceneSize;
+            fout<<(&point == sweepPoints.data() ? "\n" : ",\n");
+            fout<<"    {\"value\": "<<std::atof(point.value.c_str())<<", \"scene\": {\"geometries\": "<<size.geometries<<", \"triangles\": "<<size.triangles<<", \"textures\": "<<size.textures<<", \"texels\": "<<size.texels<<"},\n";
+            fout<<"     \"sceneBuilder\": {\"firstMs\": "<<point.sceneBuilder.first<<", \"medianMs\": "<<point.sceneBuilder.median<<", \"p95Ms\": "<<point.sceneBuilder.p95
+                <<", \"trianglesPerSecond\": "<<perSecond(size.triangles, point.sceneBuilder)<<"},\n";
+            fout<<"     \"convertToVsg\": {\"firstMs\": "<<point.convertToVsg.first<<", \"medianMs\": "<<point.convertToVsg.median<<", \"p95Ms\": "<<point.convertToVsg.p95
+                <<", \"trianglesPerSecond\": "<<perSecond(size.triangles, point.convertToVsg)<<"}}";
+        }
+        fout<<"\n  ],\n";
+        fout<<"  \"peakRSSBytes\": "<<osg2vsg::getPeakResidentSetSize()<<"\n";
+        fout<<"}"<<std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,25 @@
+#include <osg2vsg/BenchmarkUtils.h>
+
+#include <cstdlib>
+#include <new>
+
+// replacements of the global operator new/delete that count the heap allocations reported by --bench.
+// The array and nothrow forms call these, the aligned forms aren't replaced so aren't counted.
+
+void* operator new(std::size_t size)
+{
+    osg2vsg::allocationCount().fetch_add(1, std::memory_order_relaxed);
+
+    if (void* ptr = std::malloc(size > 0 ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
@@ -0,0 +1,211 @@
+#include "Benchmark.h"
+
+#include <osg2vsg/BenchmarkUtils.h>
+#include <osg2vsg/Optimize.h>
+#include <osg2vsg/SceneAnalysis.h>
+
+#include <osgDB/ReadFile>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace osg2vsg;
+
+namespace
+{
+    enum Phase
+    {
+        LOAD,
+        OPTIMISE,
+        ANALYSE,
+        BUILD,
+        SERIALISE,
+        NUM_PHASES
+    };
+
+    const char* s_phaseNames[NUM_PHASES] = {"load", "optimise", "analyse", "build", "serialise"};
+
+    // create an empty file in the system's temp directory for the serialised scenes when no -o file is given. It is created exclusively,
+    // so the name is reserved against other processes before it is written, returns an empty string if no file could be created
+    std::string createTemporaryFile(const std::string& extension)
+    {
+        std::error_code error;
+        auto directory = std::filesystem::temp_directory_path(error);
+        if (error) return std::string();
+
+        std::random_device random;
+        for(int attempt = 0; attempt < 100; ++attempt)
+        {
+            auto path = (directory / ("osg2vsg_bench_" + std::to_string(random()) + "." + extension)).string();
+
+            // the C11 "x" mode fails if the file exists, like open(O_CREAT|O_EXCL)
+            if (FILE* file = std::fopen(path.c_str(), "wbx"))
+            {
+                std::fclose(file);
+                return path;
+            }
+        }
+        return std::string();
+    }
+
+    // removes the temporary file however runBenchmark(..) returns
+    struct TemporaryFile
+    {
+        std::string filename;
+        ~TemporaryFile() { if (!filename.empty()) std::remove(filename.c_str()); }
+    };
+
+    struct PhaseResults
+    {
+        std::vector<double> times;
+        std::vector<double> allocations;
+    };
+
+    // JSON string, escaping the quotes and backslashes
+    std::string quoted(const std::string& str)
+    {
+        std::string result("\"");
+        for(auto c : str)
+        {
+            if (c == '"' || c == '\\') result.push_back('\\');
+            result.push_back(c);
+        }
+        result.push_back('"');
+        return result;
+    }
+
+    // times the phase and counts the allocations it makes
+    template<typename Func>
+    void runPhase(PhaseResults& results, Func func)
+    {
+        auto allocationsBefore = allocationCount().load();
+        auto before = std::chrono::steady_clock::now();
+
+        func();
+
+        results.times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - before).count());
+        results.allocations.push_back(static_cast<double>(allocationCount().load() - allocationsBefore));
+    }
+}
+
+int osg2vsg::runBenchmark(const BenchmarkSettings& settings, vsg::ref_ptr<BuildOptions> buildOptions)
+{
+    if (settings.filenames.empty())
+    {
+        std::cout<<"No model to benchmark."<<std::endl;
+        return 1;
+    }
+
+    std::string outputFilename = settings.outputFilename;
+    TemporaryFile temporaryFile;
+    if (outputFilename.empty())
+    {
+        outputFilename = temporaryFile.filename = createTemporaryFile(buildOptions->extension);
+        if (outputFilename.empty())
+        {
+            std::cout<<"Could not create a temporary file to serialise to."<<std::endl;
+            return 1;
+        }
+    }
+
+    PhaseResults results[NUM_PHASES];
+    SceneSize sceneSize;
+    vsg::ReaderWriter_vsg io;
+
+    for(uint32_t iteration = 0; iteration < settings.iterations; ++iteration)
+    {
+        osg::ref_ptr<osg::Node> osg_scene;
+        runPhase(results[LOAD], [&]() {
+            std::vector<std::string> filenames(settings.filenames);
+            osg_scene = osgDB::readNodeFiles(filenames);
+        });
+
+        if (!osg_scene)
+        {
+            std::cout<<"No model loaded."<<std::endl;
+            return 1;
+        }
+
+        if (iteration == 0) sceneSize = computeSceneSize(*osg_scene);
+
+        runPhase(results[OPTIMISE], [&]() {
+            if (settings.optimize) optimizeOsgScene(osg_scene.get());
+        });
+
+        runPhase(results[ANALYSE], [&]() {
+            OsgSceneAnalysis osgSceneAnalysis;
+            osg_scene->accept(osgSceneAnalysis);
+        });
+
+        // the pipelineCache is kept between iterations, so only the first iteration includes compiling the shaders
+        vsg::ref_ptr<vsg::Node> vsg_scene;
+        runPhase(results[BUILD], [&]() {
+            SceneBuilder sceneBuilder(buildOptions);
+            sceneBuilder.traverseInParallel(*osg_scene);
+
+            vsg::Paths searchPaths(settings.searchPaths);
+            vsg_scene = sceneBuilder.createVSG(searchPaths);
+        });
+
+        if (!vsg_scene)
+        {
+            std::cout<<"No vsg scene created."<<std::endl;
+            return 1;
+        }
+
+        runPhase(results[SERIALISE], [&]() {
+            io.write(vsg_scene, outputFilename);
+        });
+    }
+
+    TimingSummary summaries[NUM_PHASES];
+    for(int phase = 0; phase < NUM_PHASES; ++phase) summaries[phase] = summarizeTimings(results[phase].times);
+
+    // the throughputs are computed from the median build time as that's the conversion itself
+    double buildSeconds = summaries[BUILD].median / 1000.0;
+    double trianglesPerSecond = buildSeconds > 0.0 ? static_cast<double>(sceneSize.triangles) / buildSeconds : 0.0;
+    double texelsPerSecond = buildSeconds > 0.0 ? static_cast<double>(sceneSize.texels) / buildSeconds : 0.0;
+    uint64_t peakRSS = getPeakResidentSetSize();
+
+    std::cout<<"\nBenchmark of "<<settings.iterations<<" iterations, "<<sceneSize.geometries<<" geometries, "<<sceneSize.triangles<<" triangles, "
+             <<sceneSize.textures<<" textures, "<<sceneSize.texels<<" texels\n";
+    std::cout<<"    phase    \tFirst ms\tMin ms\tMedian ms\tP95 ms\tMedian allocations\n";
+    for(int phase = 0; phase < NUM_PHASES; ++phase)
+    {
+        auto& summary = summaries[phase];
+        std::cout<<"    "<<s_phaseNames[phase];
+        for(size_t i = strlen(s_phaseNames[phase]); i < strlen("phase    "); ++i) std::cout<<" ";
+        std::cout<<"\t"<<summary.first<<"\t"<<summary.min<<"\t"<<summary.median<<"\t"<<summary.p95<<"\t"<<percentile(results[phase].allocations, 0.5)<<"\n";
+    }
+    std::cout<<"Triangles/s "<<trianglesPerSecond<<", texels/s "<<texelsPerSecond<<", peak RSS "<<peakRSS<<" bytes"<<std::endl;
+
+    if (!settings.jsonFilename.empty())
+    {
+        std::ofstream fout(settings.jsonFilename);
+        fout<<"{\n";
+        fout<<"  \"iterations\": "<<settings.iterations<<",\n";
+        fout<<"  \"files\": [";
+        for(size_t i = 0; i < settings.filenames.size(); ++i) fout<<(i > 0 ? ", " : "")<<quoted(settings.filenames[i]);
+        fout<<"],\n";
+        fout<<"  \"scene\": {\"geometries\": "<<sceneSize.geometries<<", \"triangles\": "<<sceneSize.triangles<<", \"textures\": "<<sceneSize.textures<<", \"texels\": "<<sceneSize.texels<<"},\n";
+        fout<<"  \"phases\": {";
+        for(int phase = 0; phase < NUM_PHASES; ++phase)
+        {
+            auto& summary = summaries[phase];
+            fout<<(phase > 0 ? ",\n" : "\n")<<"    \""<<s_phaseNames[phase]<<"\": {\"firstMs\": "<<summary.first<<", \"minMs\": "<<summary.min<<", \"medianMs\": "<<summary.median
+                <<", \"p95Ms\": "<<summary.p95<<", \"meanMs\": "<<summary.mean<<", \"medianAllocations\": "<<percentile(results[phase].allocations, 0.5)<<"}";
+        }
+        fout<<"\n  },\n";
+        fout<<"  \"trianglesPerSecond\": "<<trianglesPerSecond<<",\n";
+        fout<<"  \"texelsPerSecond\": "<<texelsPerSecond<<",\n";
+        fout<<"  \"peakRSSBytes\": "<<peakRSS<<"\n";
+        fout<<"}"<<std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <osg2vsg/SceneBuilder.h>
+
+#include <string>
+#include <vector>
+
+namespace osg2vsg
+{
+    struct BenchmarkSettings
+    {
+        uint32_t iterations = 1;
+        std::vector<std::string> filenames;
+        bool optimize = true;
+        vsg::Paths searchPaths;
+
+        // file the converted scene is serialised to on each iteration, when empty a temporary file is written and removed
+        std::string outputFilename;
+
+        // file the results are written to as JSON, in addition to the table written to stdout
+        std::string jsonFilename;
+    };
+
+    // repeatedly run load, optimise, analyse, build and serialise without creating a window, so it can run on machines without a GPU.
+    // Returns the exit code for the application.
+    extern int runBenchmark(const BenchmarkSettings& settings, vsg::ref_ptr<BuildOptions> buildOptions);
+}
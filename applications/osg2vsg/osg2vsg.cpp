@@ -1,5 +1,6 @@
 #include <vsg/all.h>
 
+#include <fstream>
 #include <iostream>
 #include <ostream>
 #include <chrono>
@@ -21,6 +22,9 @@
 #include <osg2vsg/SceneBuilder.h>
 #include <osg2vsg/SceneAnalysis.h>
 #include <osg2vsg/Optimize.h>
+#include <osg2vsg/RecordSimulator.h>
+
+#include "Benchmark.h"
 
 
 namespace vsg
@@ -231,18 +235,79 @@ int main(int argc, char** argv)
     if (arguments.read("--no-cull-nodes")) buildOptions->insertCullNodes = false;
     if (arguments.read("--no-culling")) { buildOptions->insertCullGroups = false; buildOptions->insertCullNodes = false; }
     if (arguments.read("--billboard-transform")) { buildOptions->billboardTransform = true; }
+    arguments.read("--bvh", buildOptions->spatialHierarchyLeafSize);
+    if (arguments.read("--bvh-median")) buildOptions->spatialHierarchySplitMethod = osg2vsg::SplitMethod::MEDIAN;
+    if (arguments.read("--cull-cost-model")) buildOptions->useCullCostModel = true;
+    if (arguments.read("--sort-state")) buildOptions->sortStateChanges = true;
+    if (arguments.read("--front-to-back", buildOptions->eyePointHint.x, buildOptions->eyePointHint.y, buildOptions->eyePointHint.z)) buildOptions->frontToBackHint = true;
     if (arguments.read("--Geometry")) { buildOptions->geometryTarget = osg2vsg::VSG_GEOMETRY; }
     if (arguments.read("--VertexIndexDraw")) { buildOptions->geometryTarget = osg2vsg::VSG_VERTEXINDEXDRAW; }
     if (arguments.read("--Commands")) { buildOptions->geometryTarget = osg2vsg::VSG_COMMANDS; }
     if (arguments.read({"--bind-single-ds", "--bsds"})) buildOptions->useBindDescriptorSet = true;
+    arguments.read({"--threads", "--nt"}, buildOptions->numThreads);
+    if (arguments.read("--uber-shader")) buildOptions->pipelineCache->useSpecializationConstants = true;
+    if (arguments.read("--material-buffer")) buildOptions->materialStorageBuffer = true;
+    if (arguments.read("--bindless")) buildOptions->bindlessTextures = true;
+    arguments.read("--matrix-tolerance", buildOptions->matrixTolerance);
+    arguments.read("--translation-tolerance", buildOptions->matrixTranslationTolerance);
+    {
+        // limits of the device the scene will be rendered on, --material-buffer falls back to a uniform buffer per stateset and
+        // --bindless to a binding per texture unit when they are exceeded
+        auto& pipelineCache = buildOptions->pipelineCache;
+        auto& deviceLimits = pipelineCache->deviceLimits;
+        if (arguments.read("--device-limits") && !osg2vsg::queryDeviceLimits(deviceLimits)) std::cout<<"No Vulkan device found, using the guaranteed device limits."<<std::endl;
+        arguments.read("--max-push-constants", deviceLimits.maxPushConstantsSize);
+        if (uint32_t maxSamplers = 0; arguments.read("--max-samplers", maxSamplers))
+        {
+            deviceLimits.maxPerStageDescriptorSamplers = deviceLimits.maxPerStageDescriptorSampledImages = maxSamplers;
+            deviceLimits.maxDescriptorSetSamplers = deviceLimits.maxDescriptorSetSampledImages = maxSamplers;
+        }
+        if (arguments.read("--dynamic-indexing")) deviceLimits.sampledImageArrayDynamicIndexing = true;
+        arguments.read("--max-bindless-textures", pipelineCache->maxBindlessTextures);
+        if (buildOptions->materialStorageBuffer && !pipelineCache->supportsMaterialStorageBuffer())
+        {
+            std::cout<<"--material-buffer requires 132 bytes of push constants, using a uniform buffer per stateset."<<std::endl;
+        }
+        if (buildOptions->bindlessTextures && !pipelineCache->supportsBindlessTextures())
+        {
+            std::cout<<"--bindless requires --dynamic-indexing, 152 bytes of push constants and --max-bindless-textures within the sampler limits, using a binding per texture unit."<<std::endl;
+        }
+    }
+    {
+        auto& optimizeOptions = buildOptions->pipelineCache->shaderCompiler->optimizeOptions;
+        if (std::string preset; arguments.read("--spirv-opt", preset))
+        {
+            if (preset == "performance") optimizeOptions.preset = osg2vsg::ShaderOptimizeOptions::PERFORMANCE;
+            else if (preset == "size") optimizeOptions.preset = osg2vsg::ShaderOptimizeOptions::SIZE;
+            else
+            {
+                std::cout<<"Unsupported --spirv-opt preset "<<preset<<", use performance or size."<<std::endl;
+                return 1;
+            }
+        }
+        if (arguments.read("--spirv-dce")) optimizeOptions.deadCodeElimination = true;
+        if (arguments.read("--spirv-fold")) optimizeOptions.constantFolding = true;
+        if (arguments.read("--spirv-strip")) optimizeOptions.stripDebugInfo = true;
+        if (arguments.read("--spirv-validate")) optimizeOptions.validate = true;
+        if (arguments.read("--spirv-sizes")) optimizeOptions.reportSizes = true;
+    }
+    if (vsg::Path shaderCacheDirectory; arguments.read("--shader-cache", shaderCacheDirectory)) buildOptions->pipelineCache->shaderCompiler->shaderCache = osg2vsg::ShaderCache::create(shaderCacheDirectory);
     auto numFrames = arguments.value(-1, "-f");
     auto writeToFileProgramAndDataSetSets = arguments.read({"--write-stateset", "--ws"});
     auto optimize = !arguments.read("--no-optimize");
     auto outputFilename = arguments.value(std::string(), "-o");
     auto printStats = arguments.read({"-s", "--stats"});
+    if (printStats) buildOptions->reportStateChanges = true;
+    auto statsJsonFilename = arguments.value(std::string(), "--stats-json");
+    auto printTimings = arguments.read("--timings");
+    auto traceFilename = arguments.value(std::string(), "--trace");
+    auto benchIterations = arguments.value(0u, "--bench");
+    auto benchJsonFilename = arguments.value(std::string(), "--bench-json");
     auto pathFilename = arguments.value(std::string(),"-p");
     auto batchLeafData = arguments.read("--batch");
     auto simulationFrameRate = arguments.value(0.0, "--sim-fps");
+    auto simulatePathFilename = arguments.value(std::string(), "--simulate");
+    auto simulateJsonFilename = arguments.value(std::string(), "--simulate-json");
     arguments.read({"--support-mask", "--sm"}, buildOptions->supportedShaderModeMask);
     arguments.read({"--override-mask", "--om"}, buildOptions->overrideShaderModeMask);
     arguments.read({ "--vertex-shader", "--vert" }, buildOptions->vertexShaderPath);
@@ -251,6 +316,43 @@ int main(int argc, char** argv)
 
     if (arguments.errors()) return arguments.writeErrorMessages(std::cerr);
 
+    // record the timings and counters of the conversion phases when they are to be reported
+    vsg::ref_ptr<osg2vsg::RecordingInstrumentation> instrumentation;
+    if (printTimings || !traceFilename.empty())
+    {
+        instrumentation = osg2vsg::RecordingInstrumentation::create();
+        buildOptions->instrumentation = instrumentation;
+    }
+
+    auto reportInstrumentation = [&]()
+    {
+        if (!instrumentation) return;
+
+        if (printTimings) instrumentation->printSummary(std::cout);
+
+        if (!traceFilename.empty())
+        {
+            std::ofstream fout(traceFilename);
+            instrumentation->writeChromeTrace(fout);
+        }
+    };
+
+    // convert the models repeatedly without creating a window, reporting the timings of each phase
+    if (benchIterations > 0)
+    {
+        osg2vsg::BenchmarkSettings benchmarkSettings;
+        benchmarkSettings.iterations = benchIterations;
+        for(int i=1; i<argc; ++i) benchmarkSettings.filenames.push_back(arguments[i]);
+        benchmarkSettings.optimize = optimize;
+        benchmarkSettings.searchPaths = vsg::getEnvPaths("VSG_FILE_PATH");
+        benchmarkSettings.outputFilename = outputFilename;
+        benchmarkSettings.jsonFilename = benchJsonFilename;
+
+        int result = osg2vsg::runBenchmark(benchmarkSettings, buildOptions);
+        reportInstrumentation();
+        return result;
+    }
+
     osg2vsg::SceneBuilder sceneBuilder(buildOptions);
 
     // read shaders
@@ -289,7 +391,9 @@ int main(int argc, char** argv)
 
     osg::ref_ptr<osg::Node> osg_scene = osgDB::readNodeFiles(osg_arguments);
 
-    auto osg_loadTime = std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - before_osg_load).count();
+    auto after_osg_load = std::chrono::steady_clock::now();
+    auto osg_loadTime = std::chrono::duration<double, std::chrono::milliseconds::period>(after_osg_load - before_osg_load).count();
+    if (instrumentation) instrumentation->timing("osg load", before_osg_load, after_osg_load);
 
     if (vsgNodes.empty() && !osg_scene)
     {
@@ -303,27 +407,8 @@ int main(int argc, char** argv)
 
         if (optimize)
         {
-            osgUtil::IndexMeshVisitor imv;
-            #if OSG_MIN_VERSION_REQUIRED(3,6,4)
-            imv.setGenerateNewIndicesOnAllGeometries(true);
-            #endif
-            osg_scene->accept(imv);
-            imv.makeMesh();
-
-            osgUtil::VertexCacheVisitor vcv;
-            osg_scene->accept(vcv);
-            vcv.optimizeVertices();
-
-            osgUtil::VertexAccessOrderVisitor vaov;
-            osg_scene->accept(vaov);
-            vaov.optimizeOrder();
-
-            osgUtil::Optimizer optimizer;
-            optimizer.optimize(osg_scene.get(), osgUtil::Optimizer::DEFAULT_OPTIMIZATIONS);
-
-            osg2vsg::OptimizeOsgBillboards optimizeBillboards;
-            osg_scene->accept(optimizeBillboards);
-            optimizeBillboards.optimize();
+            osg2vsg::ScopedTiming timing(instrumentation.get(), "osg optimize");
+            osg2vsg::optimizeOsgScene(osg_scene.get());
         }
 
         // Collect stats for reporting.
@@ -336,11 +421,19 @@ int main(int argc, char** argv)
 
         // Collect stats about the loaded scene for the purpose of rebuild it
         sceneBuilder.writeToFileProgramAndDataSetSets = writeToFileProgramAndDataSetSets;
-        osg_scene->accept(sceneBuilder);
+        sceneBuilder.traverseInParallel(*osg_scene);
 
         // build VSG scene
         vsg::ref_ptr<vsg::Node> converted_vsg_scene = sceneBuilder.createVSG(searchPaths);
 
+        if (printStats)
+        {
+            std::cout<<"Pipelines "<<sceneBuilder.numPipelines<<", merged from "<<sceneBuilder.numRawPipelines<<" shader/geometry mask combinations"<<std::endl;
+            if (buildOptions->useCullCostModel) sceneBuilder.cullCostStats.print(std::cout);
+            std::cout<<"State changes per frame before sorting: "; sceneBuilder.unsortedStateChanges.print(std::cout, buildOptions->stateChangeCosts);
+            std::cout<<"State changes per frame after sorting: "; sceneBuilder.sortedStateChanges.print(std::cout, buildOptions->stateChangeCosts);
+        }
+
         if (converted_vsg_scene)
         {
             vsgNodes.push_back(converted_vsg_scene);
@@ -365,6 +458,30 @@ int main(int argc, char** argv)
         vsg_scene = vsgNodes.front();
     }
 
+    // report the converted scene before it is written out, neither needs a window or GPU
+    if (vsg_scene && printStats)
+    {
+        osg2vsg::VsgSceneAnalysis vsgSceneAnalysis;
+        vsg_scene->accept(vsgSceneAnalysis);
+        vsgSceneAnalysis._sceneStats->print(std::cout);
+    }
+
+    if (vsg_scene && (printStats || !statsJsonFilename.empty()))
+    {
+        osg2vsg::VsgMemoryAnalysis vsgMemoryAnalysis;
+        vsg_scene->accept(vsgMemoryAnalysis);
+        if (printStats) vsgMemoryAnalysis._memoryStats->print(std::cout);
+
+        if (!statsJsonFilename.empty())
+        {
+            std::ofstream fout(statsJsonFilename);
+            vsgMemoryAnalysis._memoryStats->writeJSON(fout);
+        }
+    }
+
+    // report the conversion phases before the -o write, which returns
+    reportInstrumentation();
+
     if (!outputFilename.empty())
     {
         vsg::Path outputFileExtension = vsg::fileExtension(outputFilename);
@@ -401,13 +518,36 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    if (printStats)
+    // count the commands recording each frame along the path would produce, without creating a window
+    if (!simulatePathFilename.empty())
     {
-        osg2vsg::VsgSceneAnalysis vsgSceneAnalysis;
-        vsg_scene->accept(vsgSceneAnalysis);
-        vsgSceneAnalysis._sceneStats->print(std::cout);
+        std::ifstream in(simulatePathFilename);
+        if (!in)
+        {
+            std::cout << "AnimationPath: Could not open animation path file \"" << simulatePathFilename << "\".\n";
+            return 1;
+        }
+
+        osg::ref_ptr<osg::AnimationPath> animationPath = new osg::AnimationPath;
+        animationPath->read(in);
+
+        osg2vsg::RecordSimulation recordSimulation;
+        recordSimulation.camera = osg2vsg::createRecordCamera(*vsg_scene, static_cast<double>(windowTraits->width) / static_cast<double>(windowTraits->height));
+        if (simulationFrameRate > 0.0) recordSimulation.frameRate = simulationFrameRate;
+        recordSimulation.run(*vsg_scene, *animationPath);
+        recordSimulation.print(std::cout, buildOptions->stateChangeCosts);
+
+        if (!simulateJsonFilename.empty())
+        {
+            std::ofstream fout(simulateJsonFilename);
+            recordSimulation.writeJSON(fout, buildOptions->stateChangeCosts);
+        }
+        return 0;
     }
 
+    // the JSON report is for sizing GPU budgets on machines without a GPU, so don't go on to create a window
+    if (!statsJsonFilename.empty()) return 0;
+
     // create the viewer and assign window(s) to it
     auto viewer = vsg::Viewer::create();
 
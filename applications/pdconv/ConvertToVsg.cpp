@@ -22,13 +22,6 @@ vsg::ref_ptr<vsg::BindGraphicsPipeline> ConvertToVsg::getOrCreateBindGraphicsPip
 
 vsg::ref_ptr<vsg::BindDescriptorSet> ConvertToVsg::getOrCreateBindDescriptorSet(uint32_t shaderModeMask, uint32_t geometryMask, osg::StateSet* stateset)
 {
-    MasksAndState masksAndState(shaderModeMask, geometryMask, stateset);
-    if (auto itr = bindDescriptorSetMap.find(masksAndState); itr != bindDescriptorSetMap.end())
-    {
-        // std::cout<<"reusing bindDescriptorSet "<<itr->second.get()<<std::endl;
-        return itr->second;
-    }
-
     auto bindGraphicsPipeline = getOrCreateBindGraphicsPipeline(shaderModeMask, geometryMask);
     if (!bindGraphicsPipeline) return {};
 
@@ -38,14 +31,22 @@ vsg::ref_ptr<vsg::BindDescriptorSet> ConvertToVsg::getOrCreateBindDescriptorSet(
     auto pipelineLayout = pipeline->getPipelineLayout();
     if (!pipelineLayout) return {};
 
-    auto descriptorSet = createVsgStateSet(pipelineLayout->getDescriptorSetLayouts(), stateset, shaderModeMask);
+    // layouts and descriptor sets are shared between compatible pipelines, so the binds can be too
+    auto descriptorSet = getOrCreateDescriptorSet(pipelineLayout->getDescriptorSetLayouts(), stateset, shaderModeMask);
     if (!descriptorSet) return {};
 
+    LayoutAndDescriptorSet layoutAndDescriptorSet(&(*pipelineLayout), descriptorSet.get());
+    if (auto itr = bindDescriptorSetMap.find(layoutAndDescriptorSet); itr != bindDescriptorSetMap.end())
+    {
+        // std::cout<<"reusing bindDescriptorSet "<<itr->second.get()<<std::endl;
+        return itr->second;
+    }
+
     // std::cout<<"   We have descriptorSet "<<descriptorSet<<std::endl;
 
     auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, descriptorSet);
 
-    bindDescriptorSetMap[masksAndState] = bindDescriptorSet;
+    bindDescriptorSetMap[layoutAndDescriptorSet] = bindDescriptorSet;
 
     return bindDescriptorSet;
 }
@@ -169,7 +170,7 @@ vsg::ref_ptr<vsg::Data> ConvertToVsg::copy(osg::Array* src_array)
 
 uint32_t ConvertToVsg::calculateShaderModeMask()
 {
-    if (statestack.empty()) return osg2vsg::ShaderModeMask::NONE;
+    if (stateStackDepth()==0) return osg2vsg::ShaderModeMask::NONE;
 
     auto& statepair = getStatePair();
 
@@ -185,7 +186,16 @@ void ConvertToVsg::apply(osg::Geometry& geometry)
     uint32_t geometryMask = (osg2vsg::calculateAttributesMask(&geometry) | buildOptions->overrideGeomAttributes) & buildOptions->supportedGeometryAttributes;
     uint32_t shaderModeMask = (calculateShaderModeMask() | buildOptions->overrideShaderModeMask | nodeShaderModeMasks) & buildOptions->supportedShaderModeMask;
 
-    // std::cout<<"Have geometry with "<<statestack.size()<<" shaderModeMask="<<shaderModeMask<<", geometryMask="<<geometryMask<<std::endl;
+    // collapse the combinations that would produce identical pipelines
+    bool builtInShaders = buildOptions->vertexShaderPath.empty() && buildOptions->fragmentShaderPath.empty();
+    std::tie(shaderModeMask, geometryMask) = osg2vsg::canonicalizeShaderMasks(shaderModeMask, geometryMask, builtInShaders);
+
+    // select the texture maps from the tile's bindless texture array, when the target device supports it
+    bool bindlessTextures = buildOptions->bindlessTextures && builtInShaders && !buildOptions->pipelineCache->useSpecializationConstants && buildOptions->pipelineCache->supportsBindlessTextures();
+    if (bindlessTextures && (shaderModeMask & (DIFFUSE_MAP | OPACITY_MAP | AMBIENT_MAP | NORMAL_MAP | SPECULAR_MAP))) shaderModeMask |= BINDLESS_TEXTURES;
+    else shaderModeMask &= ~BINDLESS_TEXTURES;
+
+    // std::cout<<"Have geometry with "<<stateStackDepth()<<" shaderModeMask="<<shaderModeMask<<", geometryMask="<<geometryMask<<std::endl;
 
     auto stategroup = vsg::StateGroup::create();
 
@@ -200,7 +210,7 @@ void ConvertToVsg::apply(osg::Geometry& geometry)
 
     auto vsg_geometry = osg2vsg::convertToVsg(&geometry, geometryMask, buildOptions->geometryTarget);
 
-    if (!statestack.empty())
+    if (stateStackDepth()>0)
     {
         auto stateset = getStatePair().second;
         //std::cout<<"   We have stateset "<<stateset<<", descriptorSetLayouts.size() = "<<descriptorSetLayouts.size()<<", "<<shaderModeMask<<std::endl;
@@ -214,6 +224,8 @@ void ConvertToVsg::apply(osg::Geometry& geometry)
                     stategroup->add(bindDescriptorSet);
                 }
             }
+
+            if (shaderModeMask & BINDLESS_TEXTURES) stategroup->add(getOrCreateTextureIndicesPushConstants(stateset, shaderModeMask));
         }
     }
 
@@ -49,8 +49,8 @@ public:
 
     vsg::ref_ptr<vsg::Node> root;
 
-    using MasksAndState = std::tuple<uint32_t, uint32_t, osg::ref_ptr<osg::StateSet>>;
-    using BindDescriptorSetMap = std::map<MasksAndState, vsg::ref_ptr<vsg::BindDescriptorSet>>;
+    using LayoutAndDescriptorSet = std::pair<const vsg::PipelineLayout*, const vsg::DescriptorSet*>;
+    using BindDescriptorSetMap = std::map<LayoutAndDescriptorSet, vsg::ref_ptr<vsg::BindDescriptorSet>>;
     BindDescriptorSetMap bindDescriptorSetMap;
     int level;
     int maxLevel;
@@ -95,12 +95,12 @@ public:
             convertToVsg(conv),
             stateset(ss)
         {
-            if (stateset) convertToVsg.statestack.push_back(stateset);
+            if (stateset) convertToVsg.pushStateSet(*stateset);
         }
 
         ~ScopedPushPop()
         {
-            if (stateset) convertToVsg.statestack.pop_back();
+            if (stateset) convertToVsg.popStateSet();
         }
     };
 
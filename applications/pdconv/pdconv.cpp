@@ -38,6 +38,46 @@ int main(int argc, char** argv)
     if (arguments.read("--VertexIndexDraw")) { buildOptions->geometryTarget = osg2vsg::VSG_VERTEXINDEXDRAW; }
     if (arguments.read("--Commands")) { buildOptions->geometryTarget = osg2vsg::VSG_COMMANDS; }
     if (arguments.read({"--bind-single-ds", "--bsds"})) buildOptions->useBindDescriptorSet = true;
+    if (arguments.read("--build-threads", buildOptions->numThreads)) {}
+    if (arguments.read("--uber-shader")) buildOptions->pipelineCache->useSpecializationConstants = true;
+    if (arguments.read("--bindless")) buildOptions->bindlessTextures = true;
+    {
+        // limits of the device the scene will be rendered on, --bindless falls back to a binding per texture unit when they are exceeded
+        auto& pipelineCache = buildOptions->pipelineCache;
+        auto& deviceLimits = pipelineCache->deviceLimits;
+        if (arguments.read("--device-limits") && !osg2vsg::queryDeviceLimits(deviceLimits)) std::cout<<"No Vulkan device found, using the guaranteed device limits."<<std::endl;
+        arguments.read("--max-push-constants", deviceLimits.maxPushConstantsSize);
+        if (uint32_t maxSamplers = 0; arguments.read("--max-samplers", maxSamplers))
+        {
+            deviceLimits.maxPerStageDescriptorSamplers = deviceLimits.maxPerStageDescriptorSampledImages = maxSamplers;
+            deviceLimits.maxDescriptorSetSamplers = deviceLimits.maxDescriptorSetSampledImages = maxSamplers;
+        }
+        if (arguments.read("--dynamic-indexing")) deviceLimits.sampledImageArrayDynamicIndexing = true;
+        arguments.read("--max-bindless-textures", pipelineCache->maxBindlessTextures);
+        if (buildOptions->bindlessTextures && !pipelineCache->supportsBindlessTextures())
+        {
+            std::cout<<"--bindless requires --dynamic-indexing, 152 bytes of push constants and --max-bindless-textures within the sampler limits, using a binding per texture unit."<<std::endl;
+        }
+    }
+    {
+        auto& optimizeOptions = buildOptions->pipelineCache->shaderCompiler->optimizeOptions;
+        if (std::string preset; arguments.read("--spirv-opt", preset))
+        {
+            if (preset == "performance") optimizeOptions.preset = osg2vsg::ShaderOptimizeOptions::PERFORMANCE;
+            else if (preset == "size") optimizeOptions.preset = osg2vsg::ShaderOptimizeOptions::SIZE;
+            else
+            {
+                std::cout<<"Unsupported --spirv-opt preset "<<preset<<", use performance or size."<<std::endl;
+                return 1;
+            }
+        }
+        if (arguments.read("--spirv-dce")) optimizeOptions.deadCodeElimination = true;
+        if (arguments.read("--spirv-fold")) optimizeOptions.constantFolding = true;
+        if (arguments.read("--spirv-strip")) optimizeOptions.stripDebugInfo = true;
+        if (arguments.read("--spirv-validate")) optimizeOptions.validate = true;
+        if (arguments.read("--spirv-sizes")) optimizeOptions.reportSizes = true;
+    }
+    if (vsg::Path shaderCacheDirectory; arguments.read("--shader-cache", shaderCacheDirectory)) buildOptions->pipelineCache->shaderCompiler->shaderCache = osg2vsg::ShaderCache::create(shaderCacheDirectory);
 
     if (inputFilename.empty() || outputFilename.empty())
     {
@@ -133,6 +173,14 @@ int main(int argc, char** argv)
 
                 sceneBuilder.optimize(osg_scene);
 
+                // convert the textures up front so that they can be converted in parallel
+                osg2vsg::SceneBuilderBase::Textures textures;
+                sceneBuilder.collectTextures(osg_scene, textures);
+                sceneBuilder.convertTextures(textures);
+
+                // each tile has its own bindless texture array, the ResourceHints computed below count all its elements
+                if (buildOptions->bindlessTextures && buildOptions->pipelineCache->supportsBindlessTextures()) sceneBuilder.assignTextureIndices(textures);
+
                 auto vsg_scene = sceneBuilder.convert(osg_scene);
 
                 if (vsg_scene)
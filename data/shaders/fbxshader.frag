@@ -1,6 +1,28 @@
 #version 450
-#pragma import_defines ( VSG_NORMAL, VSG_COLOR, VSG_TEXCOORD0, VSG_LIGHTING, VSG_MATERIAL, VSG_DIFFUSE_MAP, VSG_OPACITY_MAP, VSG_AMBIENT_MAP, VSG_NORMAL_MAP, VSG_SPECULAR_MAP )
+#pragma import_defines ( VSG_NORMAL, VSG_COLOR, VSG_TEXCOORD0, VSG_LIGHTING, VSG_MATERIAL, VSG_DIFFUSE_MAP, VSG_OPACITY_MAP, VSG_AMBIENT_MAP, VSG_NORMAL_MAP, VSG_SPECULAR_MAP, VSG_MATERIAL_BUFFER, VSG_BINDLESS_TEXTURES )
 #extension GL_ARB_separate_shader_objects : enable
+#if defined(VSG_MATERIAL_BUFFER) || defined(VSG_BINDLESS_TEXTURES)
+layout(push_constant) uniform FragmentPushConstants
+{
+    layout(offset = 128) uint materialIndex;
+#ifdef VSG_BINDLESS_TEXTURES
+    uint diffuseIndex;
+    uint opacityIndex;
+    uint ambientIndex;
+    uint normalIndex;
+    uint specularIndex;
+#endif
+} fpc;
+#endif
+#ifdef VSG_BINDLESS_TEXTURES
+layout(constant_id = 0) const uint maxBindlessTextures = 16;
+layout(binding = 11) uniform sampler2D textures[maxBindlessTextures];
+#define diffuseMap textures[fpc.diffuseIndex]
+#define opacityMap textures[fpc.opacityIndex]
+#define ambientMap textures[fpc.ambientIndex]
+#define normalMap textures[fpc.normalIndex]
+#define specularMap textures[fpc.specularIndex]
+#else
 #ifdef VSG_DIFFUSE_MAP
 layout(binding = 0) uniform sampler2D diffuseMap;
 #endif
@@ -16,8 +38,23 @@ layout(binding = 5) uniform sampler2D normalMap;
 #ifdef VSG_SPECULAR_MAP
 layout(binding = 6) uniform sampler2D specularMap;
 #endif
+#endif
 
 #ifdef VSG_MATERIAL
+#ifdef VSG_MATERIAL_BUFFER
+struct MaterialData
+{
+    vec4 ambientColor;
+    vec4 diffuseColor;
+    vec4 specularColor;
+    float shine;
+};
+layout(std430, binding = 10) readonly buffer Materials
+{
+    MaterialData materials[];
+};
+#define material materials[fpc.materialIndex]
+#else
 layout(binding = 10) uniform MaterialData
 {
     vec4 ambientColor;
@@ -26,6 +63,7 @@ layout(binding = 10) uniform MaterialData
     float shine;
 } material;
 #endif
+#endif
 
 #ifdef VSG_NORMAL
 layout(location = 1) in vec3 normalDir;
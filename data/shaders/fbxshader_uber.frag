@@ -0,0 +1,102 @@
+#version 450
+#pragma import_defines ( VSG_NORMAL, VSG_COLOR, VSG_TEXCOORD0 )
+#extension GL_ARB_separate_shader_objects : enable
+
+// shading features are specialization constants so one module serves all the shaderModeMask combinations
+layout(constant_id = 0) const bool lighting = false;
+layout(constant_id = 1) const bool materialEnabled = false;
+layout(constant_id = 2) const bool diffuseMapping = false;
+layout(constant_id = 3) const bool opacityMapping = false;
+layout(constant_id = 4) const bool ambientMapping = false;
+layout(constant_id = 5) const bool normalMapping = false;
+layout(constant_id = 6) const bool specularMapping = false;
+
+// all the samplers and the material are always bound so every variant shares the same descriptor set layout
+layout(binding = 0) uniform sampler2D diffuseMap;
+layout(binding = 1) uniform sampler2D opacityMap;
+layout(binding = 4) uniform sampler2D ambientMap;
+layout(binding = 5) uniform sampler2D normalMap;
+layout(binding = 6) uniform sampler2D specularMap;
+
+layout(binding = 10) uniform MaterialData
+{
+    vec4 ambientColor;
+    vec4 diffuseColor;
+    vec4 specularColor;
+    float shine;
+} material;
+
+#ifdef VSG_NORMAL
+layout(location = 1) in vec3 normalDir;
+layout(location = 5) in vec3 viewDir;
+layout(location = 6) in vec3 lightDir;
+#endif
+#ifdef VSG_COLOR
+layout(location = 3) in vec4 vertColor;
+#endif
+#ifdef VSG_TEXCOORD0
+layout(location = 4) in vec2 texCoord0;
+#endif
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    vec4 base = vec4(1.0,1.0,1.0,1.0);
+#ifdef VSG_TEXCOORD0
+    if (diffuseMapping) base = texture(diffuseMap, texCoord0.st);
+#endif
+#ifdef VSG_COLOR
+    base = base * vertColor;
+#endif
+    vec3 ambientColor = vec3(0.1,0.1,0.1);
+    vec3 diffuseColor = vec3(1.0,1.0,1.0);
+    vec3 specularColor = vec3(0.3,0.3,0.3);
+    float shine = 16.0;
+    if (materialEnabled)
+    {
+        ambientColor = material.ambientColor.rgb;
+        diffuseColor = material.diffuseColor.rgb;
+        specularColor = material.specularColor.rgb;
+        shine = material.shine;
+    }
+#ifdef VSG_TEXCOORD0
+    if (ambientMapping) ambientColor *= texture(ambientMap, texCoord0.st).r;
+    if (specularMapping) specularColor = texture(specularMap, texCoord0.st).rrr;
+#endif
+    vec4 color = base;
+    color.rgb *= diffuseColor;
+#ifdef VSG_NORMAL
+    if (lighting)
+    {
+        vec3 nDir = normalDir;
+#ifdef VSG_TEXCOORD0
+        if (normalMapping)
+        {
+            nDir = texture(normalMap, texCoord0.st).xyz*2.0 - 1.0;
+            nDir.g = -nDir.g;
+        }
+#endif
+        vec3 nd = normalize(nDir);
+        vec3 ld = normalize(lightDir);
+        vec3 vd = normalize(viewDir);
+        color = vec4(0.01, 0.01, 0.01, 1.0);
+        color.rgb += ambientColor;
+        float diff = max(dot(ld, nd), 0.0);
+        color.rgb += diffuseColor * diff;
+        color *= base;
+        if (diff > 0.0)
+        {
+            vec3 halfDir = normalize(ld + vd);
+            color.rgb += base.a * specularColor *
+                pow(max(dot(halfDir, nd), 0.0), shine);
+        }
+    }
+#endif
+    outColor = color;
+#ifdef VSG_TEXCOORD0
+    if (opacityMapping) outColor.a *= texture(opacityMap, texCoord0.st).r;
+#endif
+
+    // crude version of AlphaFunc
+    if (outColor.a==0.0) discard;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <osg2vsg/Export.h>
+
+#include <osg/Node>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace osg2vsg
+{
+    // times taken by a phase over the iterations of a benchmark, in milliseconds. The first iteration is kept separately as it runs with cold caches.
+    struct TimingSummary
+    {
+        double first = 0.0;
+        double min = 0.0;
+        double median = 0.0;
+        double p95 = 0.0;
+        double mean = 0.0;
+    };
+
+    extern OSG2VSG_DECLSPEC TimingSummary summarizeTimings(const std::vector<double>& times);
+
+    // nearest rank percentile of the values, fraction in the range [0, 1]
+    extern OSG2VSG_DECLSPEC double percentile(std::vector<double> values, double fraction);
+
+    // peak resident set size of the process in bytes, 0 on platforms where it isn't available
+    extern OSG2VSG_DECLSPEC uint64_t getPeakResidentSetSize();
+
+    // number of heap allocations made by the process. Only counted in applications that replace the global operator new to increment it,
+    // see applications/osg2vsg/AllocationCounter.cpp
+    extern OSG2VSG_DECLSPEC std::atomic<uint64_t>& allocationCount();
+
+    // amount of work in an osg scene, used to compute the conversion throughput
+    struct SceneSize
+    {
+        uint64_t geometries = 0;
+        uint64_t triangles = 0;
+        uint64_t textures = 0;
+        uint64_t texels = 0; // of the base level of each image
+    };
+
+    extern OSG2VSG_DECLSPEC SceneSize computeSceneSize(osg::Node& node);
+}
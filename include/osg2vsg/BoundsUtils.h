@@ -0,0 +1,64 @@
+#pragma once
+
+#include <osg2vsg/Export.h>
+
+#include <osg/Array>
+#include <osg/BoundingBox>
+#include <osg/BoundingSphere>
+#include <osg/Geometry>
+#include <osg/Matrix>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace osg2vsg
+{
+    // box aligned to three orthogonal unit axes, invalid until the halfExtents are set
+    struct OrientedBox
+    {
+        osg::Vec3 center;
+        osg::Vec3 axes[3] = {osg::Vec3(1.0f, 0.0f, 0.0f), osg::Vec3(0.0f, 1.0f, 0.0f), osg::Vec3(0.0f, 0.0f, 1.0f)};
+        osg::Vec3 halfExtents = osg::Vec3(-1.0f, -1.0f, -1.0f);
+
+        bool valid() const { return halfExtents.x() >= 0.0f; }
+        float volume() const { return 8.0f * halfExtents.x() * halfExtents.y() * halfExtents.z(); }
+    };
+
+    // near minimal sphere enclosing the vertices, using Ritter's algorithm
+    extern OSG2VSG_DECLSPEC osg::BoundingSphere computeRitterSphere(const osg::Vec3Array& vertices);
+
+    // box aligned with the principal axes of the vertices, tighter than an axis aligned box for elongated parts that aren't aligned to the axes
+    extern OSG2VSG_DECLSPEC OrientedBox computeOrientedBox(const osg::Vec3Array& vertices);
+
+    // axis aligned box enclosing the transformed box, using Arvo's method
+    extern OSG2VSG_DECLSPEC osg::BoundingBox transformBox(const osg::BoundingBox& bb, const osg::Matrix& matrix);
+    extern OSG2VSG_DECLSPEC osg::BoundingBox transformBox(const OrientedBox& box, const osg::Matrix& matrix);
+
+    // sphere enclosing the transformed sphere, the radius is scaled by the largest singular value of the matrix
+    extern OSG2VSG_DECLSPEC osg::BoundingSphere transformSphere(const osg::BoundingSphere& sphere, const osg::Matrix& matrix);
+
+    struct GeometryBounds
+    {
+        osg::BoundingBox box;
+        osg::BoundingSphere sphere; // the smallest of the Ritter sphere and the spheres around the box and obb
+        OrientedBox obb;
+    };
+
+    // bounds computed once for each geometry, safe to use from multiple threads
+    class OSG2VSG_DECLSPEC BoundsCache
+    {
+    public:
+        // the first call for a geometry computes its bounds with osg::Drawable::getBoundingBox(), which caches them in the geometry
+        // without locking, so it must not be made concurrently with other calls that access the same geometry
+        GeometryBounds getBounds(osg::Geometry* geometry);
+
+        // sphere enclosing the geometries transformed by the matrix
+        osg::BoundingSphere computeBound(const std::vector<osg::ref_ptr<osg::Geometry>>& geometries, const osg::Matrix& matrix);
+
+        void clear();
+
+    protected:
+        std::mutex _mutex;
+        std::unordered_map<const osg::Geometry*, GeometryBounds> _bounds;
+    };
+}
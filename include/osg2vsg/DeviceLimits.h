@@ -0,0 +1,27 @@
+#pragma once
+
+#include <osg2vsg/Export.h>
+
+#include <vsg/all.h>
+
+namespace osg2vsg
+{
+    // limits of the device the converted scenes will be rendered on, which decide whether the material storage buffer and
+    // bindless texture layouts can be used. The defaults are the minimums the Vulkan specification guarantees.
+    struct DeviceLimits
+    {
+        uint32_t maxPushConstantsSize = 128;
+        uint32_t maxPerStageDescriptorSamplers = 16;
+        uint32_t maxPerStageDescriptorSampledImages = 16;
+        uint32_t maxDescriptorSetSamplers = 96;
+        uint32_t maxDescriptorSetSampledImages = 96;
+
+        // the shaderSampledImageArrayDynamicIndexing feature has to be enabled on the VkDevice by the viewer rendering
+        // the scenes, being supported by the physical device isn't enough, so it is only set by the application
+        bool sampledImageArrayDynamicIndexing = false;
+    };
+
+    // set limits to the minimum of each limit across the physical devices of this system's Vulkan implementation,
+    // returns false, leaving limits unchanged, if there is no Vulkan device
+    extern OSG2VSG_DECLSPEC bool queryDeviceLimits(DeviceLimits& limits);
+}
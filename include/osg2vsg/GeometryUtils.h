@@ -1,6 +1,7 @@
 #pragma once
 
 #include <osg2vsg/Export.h>
+#include <osg2vsg/Instrumentation.h>
 #include <vsg/all.h>
 
 #include <osg/Array>
@@ -56,6 +57,8 @@ namespace osg2vsg
 
     extern OSG2VSG_DECLSPEC uint32_t calculateAttributesMask(const osg::Geometry* geometry);
 
+    extern OSG2VSG_DECLSPEC uint32_t computeNumTriangles(const osg::Geometry* geometry);
+
     extern OSG2VSG_DECLSPEC VkPrimitiveTopology convertToTopology(osg::PrimitiveSet::Mode primitiveMode);
 
     extern OSG2VSG_DECLSPEC VkSamplerAddressMode covertToSamplerAddressMode(osg::Texture::WrapMode wrapmode);
@@ -66,6 +69,7 @@ namespace osg2vsg
 
     extern OSG2VSG_DECLSPEC vsg::ref_ptr<vsg::MaterialValue> convertToMaterialValue(const osg::Material* material);
 
-    extern OSG2VSG_DECLSPEC vsg::ref_ptr<vsg::Command> convertToVsg(osg::Geometry* geometry, uint32_t requiredAttributesMask, GeometryTarget geometryTarget);
+    // optional instrumentation receives the time spent generating tangents
+    extern OSG2VSG_DECLSPEC vsg::ref_ptr<vsg::Command> convertToVsg(osg::Geometry* geometry, uint32_t requiredAttributesMask, GeometryTarget geometryTarget, Instrumentation* instrumentation = nullptr);
 
 }
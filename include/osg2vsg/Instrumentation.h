@@ -0,0 +1,91 @@
+#pragma once
+
+#include <osg2vsg/Export.h>
+
+#include <vsg/core/Inherit.h>
+#include <vsg/core/Object.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace osg2vsg
+{
+    // sink for the timings and counters of the phases of a conversion. Phases run on several threads so implementations must be thread safe.
+    // The names passed in are string literals so can be kept without copying.
+    class OSG2VSG_DECLSPEC Instrumentation : public vsg::Inherit<vsg::Object, Instrumentation>
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        virtual void timing(const char* name, clock::time_point start, clock::time_point end) = 0;
+        virtual void counter(const char* name, int64_t value) = 0;
+    };
+
+    // keeps all the events in memory so they can be exported as a Chrome trace (chrome://tracing or ui.perfetto.dev) or summarised as a table
+    class OSG2VSG_DECLSPEC RecordingInstrumentation : public vsg::Inherit<Instrumentation, RecordingInstrumentation>
+    {
+    public:
+        RecordingInstrumentation();
+
+        void timing(const char* name, clock::time_point start, clock::time_point end) override;
+        void counter(const char* name, int64_t value) override;
+
+        void writeChromeTrace(std::ostream& out) const;
+        void printSummary(std::ostream& out) const;
+
+        void clear();
+
+    protected:
+        struct Event
+        {
+            const char* name;
+            uint32_t thread;
+            clock::time_point start;
+            clock::time_point end;
+            int64_t value; // counter events have start==end
+            bool isCounter;
+        };
+
+        uint32_t threadIndex();
+
+        mutable std::mutex _mutex;
+        clock::time_point _origin;
+        std::vector<Event> _events;
+        std::map<std::thread::id, uint32_t> _threadIndices;
+    };
+
+    // reports the time spent in its scope, when instrumentation is null the only cost is the null checks
+    class ScopedTiming
+    {
+    public:
+        ScopedTiming(Instrumentation* instrumentation, const char* name) :
+            _instrumentation(instrumentation),
+            _name(name)
+        {
+            if (_instrumentation) _start = Instrumentation::clock::now();
+        }
+
+        ~ScopedTiming()
+        {
+            if (_instrumentation) _instrumentation->timing(_name, _start, Instrumentation::clock::now());
+        }
+
+        ScopedTiming(const ScopedTiming&) = delete;
+        ScopedTiming& operator=(const ScopedTiming&) = delete;
+
+    protected:
+        Instrumentation* _instrumentation;
+        const char* _name;
+        Instrumentation::clock::time_point _start;
+    };
+
+    inline void count(Instrumentation* instrumentation, const char* name, int64_t value)
+    {
+        if (instrumentation) instrumentation->counter(name, value);
+    }
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <osg2vsg/Export.h>
+
 #include <vsg/all.h>
 
 #include <osg/Billboard>
@@ -30,4 +32,7 @@ namespace osg2vsg
         void optimize();
 
     };
+
+    // the osgUtil mesh and scene graph optimizations followed by OptimizeOsgBillboards, as applied before conversion
+    extern OSG2VSG_DECLSPEC void optimizeOsgScene(osg::Node* scene);
 }
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <osg2vsg/Export.h>
+#include <osg2vsg/SceneBuilder.h>
+
+#include <vsg/all.h>
+
+#include <osg/AnimationPath>
+
+#include <ostream>
+#include <vector>
+
+namespace osg2vsg
+{
+    // commands a record traversal of a vsg scene graph would put in the command buffer for one frame
+    struct RecordStats
+    {
+        uint64_t pipelineBinds = 0;
+        uint64_t descriptorSetBinds = 0;
+        uint64_t pushConstants = 0;
+        uint64_t vertexBufferBinds = 0;
+        uint64_t indexBufferBinds = 0;
+        uint64_t draws = 0;
+        uint64_t triangles = 0; // assumes the draws are of triangle lists
+        uint64_t culledNodes = 0; // CullGroups, CullNodes and LODs outside the view frustum
+        uint64_t redundantBinds = 0; // state binds of the same commands that were already bound
+
+        double cost(const StateChangeCosts& costs) const;
+    };
+
+    // perspective camera the scene is recorded from, matching the one osg2vsg sets up for its window
+    struct RecordCamera
+    {
+        double fieldOfViewY = 30.0; // degrees
+        double aspectRatio = 1.0;
+        double nearDistance = 0.1;
+        double farDistance = 1000.0;
+    };
+
+    // CPU only simulation of the record traversal of a vsg scene graph, performing the frustum culling and LOD selection
+    // and state stack handling it does, and counting the commands it would record rather than recording them.
+    class OSG2VSG_DECLSPEC RecordSimulator : public vsg::ConstVisitor
+    {
+    public:
+
+        RecordSimulator(const RecordCamera& camera, const vsg::dmat4& viewMatrix);
+
+        RecordStats stats;
+
+        void apply(const vsg::Object& object) override;
+        void apply(const vsg::StateGroup& stategroup) override;
+        void apply(const vsg::MatrixTransform& transform) override;
+        void apply(const vsg::CullGroup& cullGroup) override;
+        void apply(const vsg::CullNode& cullNode) override;
+        void apply(const vsg::LOD& lod) override;
+        void apply(const vsg::PagedLOD& plod) override;
+        void apply(const vsg::Geometry& geometry) override;
+        void apply(const vsg::VertexIndexDraw& vid) override;
+        void apply(const vsg::BindVertexBuffers& bvb) override;
+        void apply(const vsg::BindIndexBuffer& bib) override;
+
+    protected:
+
+        enum StateCategory
+        {
+            PIPELINE,
+            DESCRIPTOR_SETS,
+            PUSH_CONSTANTS,
+            OTHER_STATE,
+            NUM_STATE_CATEGORIES
+        };
+
+        using StateCommands = std::vector<const vsg::Object*>;
+
+        // like vsg::State's stacks, pushing or popping marks the stack dirty so its top is bound before the next draw
+        struct StateStack
+        {
+            std::vector<StateCommands> stack;
+            StateCommands bound;
+            bool dirty = false;
+        };
+
+        // scale the modelview matrix applies to the radius of a sphere
+        double modelviewScale() const;
+
+        template<typename T>
+        bool intersect(const vsg::t_sphere<T>& sphere) const;
+
+        template<typename T>
+        double eyeDistance(const vsg::t_sphere<T>& sphere) const;
+
+        void dispatch();
+        void draw(const vsg::Object& command);
+
+        double _tanHalfFieldOfViewY;
+        double _tanHalfFieldOfViewX;
+        double _projectionScale;
+        RecordCamera _camera;
+        std::vector<vsg::dmat4> _modelviewStack;
+        StateStack _stateStacks[NUM_STATE_CATEGORIES];
+    };
+
+    // records of each frame of an animation path
+    struct OSG2VSG_DECLSPEC RecordSimulation
+    {
+        RecordCamera camera;
+        double frameRate = 60.0;
+        std::vector<RecordStats> frames;
+
+        // simulate recording the scene from the camera positions along the path, one frame every 1/frameRate seconds of its period
+        void run(const vsg::Node& scene, const osg::AnimationPath& path);
+
+        void print(std::ostream& out, const StateChangeCosts& costs) const;
+        void writeJSON(std::ostream& out, const StateChangeCosts& costs) const;
+    };
+
+    // camera with the near and far distances osg2vsg computes from the bounds of the scene
+    extern OSG2VSG_DECLSPEC RecordCamera createRecordCamera(vsg::Node& scene, double aspectRatio);
+}
@@ -4,6 +4,7 @@
 
 #include <osg/Geometry>
 
+#include <set>
 #include <typeindex>
 
 
@@ -59,4 +60,87 @@ namespace osg2vsg
         //void apply(const vsg::Commands& commands) override;
     };
 
+    // GPU memory required by the data of a vsg scene graph, each data object is counted once however many times it's referenced
+    struct MemoryStats : public vsg::Object
+    {
+        enum Category
+        {
+            VERTEX_DATA,
+            INDEX_DATA,
+            TEXTURE_DATA,
+            UNIFORM_DATA, // uniform and storage buffers
+            NUM_CATEGORIES
+        };
+
+        struct DataEntry
+        {
+            uint64_t bytes = 0;
+            uint32_t references = 0;
+        };
+
+        struct Summary
+        {
+            uint64_t objects = 0;
+            uint64_t bytes = 0;
+            uint64_t sharedObjects = 0; // objects referenced more than once
+            uint64_t sharedBytes = 0;
+            uint64_t referencedBytes = 0; // bytes that would be required if nothing were shared
+        };
+
+        // the state and data used below a pipeline bind, the data is counted once per pipeline
+        struct PipelineStats
+        {
+            std::set<const vsg::DescriptorSet*> descriptorSets;
+            std::set<const vsg::Data*> data;
+            uint32_t draws = 0;
+            uint64_t bytes[NUM_CATEGORIES] = {};
+        };
+
+        std::map<const vsg::Data*, DataEntry> dataEntries[NUM_CATEGORIES];
+        std::set<const vsg::DescriptorSet*> descriptorSets;
+        uint32_t numDescriptors = 0;
+
+        // pipelines in the order they are first bound, state bound outside of any pipeline's subgraph is keyed by nullptr
+        std::vector<const vsg::BindGraphicsPipeline*> pipelines;
+        std::map<const vsg::BindGraphicsPipeline*, PipelineStats> pipelineStats;
+
+        void insert(Category category, const vsg::Data* data, uint64_t bytes, const vsg::BindGraphicsPipeline* pipeline);
+
+        Summary summarize(Category category) const;
+        uint64_t totalBytes() const;
+
+        void print(std::ostream& out) const;
+        void writeJSON(std::ostream& out) const;
+    };
+
+    // bytes of GPU memory required by the image, including the mip levels the sampler can access and the blocks of compressed formats
+    extern uint64_t computeImageBytes(const vsg::Data& data, const vsg::Sampler* sampler);
+
+    class VsgMemoryAnalysis : public vsg::ConstVisitor
+    {
+    public:
+
+        vsg::ref_ptr<MemoryStats> _memoryStats;
+
+        VsgMemoryAnalysis();
+        VsgMemoryAnalysis(MemoryStats* memoryStats);
+
+        void apply(const vsg::Object& object) override;
+        void apply(const vsg::Geometry& geometry) override;
+        void apply(const vsg::VertexIndexDraw& vid) override;
+        void apply(const vsg::BindVertexBuffers& bvb) override;
+        void apply(const vsg::BindIndexBuffer& bib) override;
+        void apply(const vsg::StateGroup& stategroup) override;
+        void apply(const vsg::DescriptorSet& descriptorSet) override;
+
+    protected:
+
+        using DescriptorData = std::vector<std::pair<MemoryStats::Category, const vsg::Data*>>;
+
+        void insertDescriptors(const vsg::DescriptorSet& descriptorSet, DescriptorData& descriptorData);
+
+        const vsg::BindGraphicsPipeline* _currentPipeline = nullptr;
+        std::map<const vsg::DescriptorSet*, DescriptorData> _descriptorSetData;
+    };
+
 }
@@ -4,6 +4,12 @@
 
 #include <iostream>
 #include <chrono>
+#include <future>
+#include <memory>
+#include <unordered_map>
+#include <array>
+#include <cmath>
+#include <cstring>
 
 #include <osgDB/ReadFile>
 #include <osgDB/WriteFile>
@@ -13,6 +19,11 @@
 
 #include <osg2vsg/ShaderUtils.h>
 #include <osg2vsg/GeometryUtils.h>
+#include <osg2vsg/StateSetUtils.h>
+#include <osg2vsg/SpatialHierarchy.h>
+#include <osg2vsg/BoundsUtils.h>
+#include <osg2vsg/DeviceLimits.h>
+#include <osg2vsg/Instrumentation.h>
 
 namespace osg2vsg
 {
@@ -22,11 +33,77 @@ namespace osg2vsg
 
         using Key = std::tuple<uint32_t, uint32_t, std::string, std::string>;
         using PipelineMap = std::map<Key, vsg::ref_ptr<vsg::BindGraphicsPipeline>>;
+        using PendingMap = std::map<Key, std::shared_future<vsg::ref_ptr<vsg::BindGraphicsPipeline>>>;
 
         std::mutex mutex;
         PipelineMap pipelineMap;
+        PendingMap pendingMap; // pipelines currently being created, so other threads requesting the same Key wait on them rather than compiling again
+
+        // use the fbx uber shaders, which switch shading features with specialization constants rather than #defines, in place of the built in shaders.
+        // Pipelines using them share shader modules and a single descriptor set layout that always contains the material and all the textures.
+        bool useSpecializationConstants = false;
+
+        // optional sink for the shader preprocessing timings, SceneBuilder::createVSG(..) sets it from BuildOptions::instrumentation
+        vsg::ref_ptr<Instrumentation> instrumentation;
+
+        // limits of the target device, the material storage buffer falls back to a uniform buffer per stateset, and bindless textures
+        // to a binding per texture unit, when they exceed them
+        DeviceLimits deviceLimits;
+
+        // number of elements in the bindless texture array, must be no more than the device's per stage and per set sampler limits
+        uint32_t maxBindlessTextures = DEFAULT_MAX_BINDLESS_TEXTURES;
+
+        // the fragment shader's material index follows the vertex shader's 128 bytes of matrices in the push constants
+        bool supportsMaterialStorageBuffer() const;
+
+        // the fragment shader's texture indices follow the vertex shader's 128 bytes of matrices in the push constants, and index the array dynamically
+        bool supportsBindlessTextures() const;
+
+        bool usesUberShaders(const std::string& vertShaderPath, const std::string& fragShaderPath) const { return useSpecializationConstants && vertShaderPath.empty() && fragShaderPath.empty(); }
 
         vsg::ref_ptr<vsg::BindGraphicsPipeline> getOrCreateBindGraphicsPipeline(uint32_t shaderModeMask, uint32_t geometryMask, const std::string& vertShaderPath = "", const std::string& fragShaderPath = "");
+
+        // layouts are interned by their bindings so pipelines with the same bindings share layout objects, and so can share descriptor sets and their binds
+        vsg::ref_ptr<vsg::DescriptorSetLayout> getOrCreateDescriptorSetLayout(const vsg::DescriptorSetLayoutBindings& descriptorBindings);
+        vsg::ref_ptr<vsg::PipelineLayout> getOrCreatePipelineLayout(const vsg::DescriptorSetLayouts& descriptorSetLayouts, const vsg::PushConstantRanges& pushConstantRanges);
+
+    protected:
+        using DescriptorSetLayoutKey = std::vector<std::tuple<uint32_t, VkDescriptorType, uint32_t, VkShaderStageFlags, const VkSampler*>>;
+        using PipelineLayoutKey = std::pair<std::vector<const vsg::DescriptorSetLayout*>, std::vector<std::tuple<VkShaderStageFlags, uint32_t, uint32_t>>>;
+
+        std::mutex layoutMutex;
+        std::map<DescriptorSetLayoutKey, vsg::ref_ptr<vsg::DescriptorSetLayout>> descriptorSetLayouts;
+        std::map<PipelineLayoutKey, vsg::ref_ptr<vsg::PipelineLayout>> pipelineLayouts;
+
+        using ShaderModulePair = std::pair<vsg::ref_ptr<vsg::ShaderModule>, vsg::ref_ptr<vsg::ShaderModule>>;
+
+        std::mutex uberShaderMutex;
+        std::map<uint32_t, ShaderModulePair> uberShaderModules;
+
+        bool compileShaders(vsg::ShaderStages& shaders);
+        vsg::ShaderStages createUberShaderStages(uint32_t shaderModeMask, uint32_t geometryMask);
+        vsg::ref_ptr<vsg::BindGraphicsPipeline> createBindGraphicsPipeline(uint32_t shaderModeMask, uint32_t geometryMask, const std::string& vertShaderPath, const std::string& fragShaderPath);
+    };
+
+    // relative costs of the state changes between draws, used to order the state groups created by SceneBuilder::createVSG(..)
+    struct StateChangeCosts
+    {
+        float pipeline = 10.0f;
+        float descriptorSet = 4.0f;
+        float vertexBuffers = 1.0f;
+        float pushConstants = 0.5f;
+    };
+
+    // number of state changes expected per frame when all the state groups are drawn in order
+    struct StateChangeStats
+    {
+        uint32_t pipelines = 0;
+        uint32_t descriptorSets = 0;
+        uint32_t vertexBuffers = 0;
+        uint32_t pushConstants = 0;
+
+        float cost(const StateChangeCosts& costs) const;
+        void print(std::ostream& out, const StateChangeCosts& costs) const;
     };
 
     struct BuildOptions : public vsg::Inherit<vsg::Object, BuildOptions>
@@ -36,6 +113,46 @@ namespace osg2vsg
         bool useBindDescriptorSet = true;
         bool billboardTransform = false;
 
+        // place the culled subgraphs of each state group in a bounding volume hierarchy of nested CullGroups with up to spatialHierarchyLeafSize
+        // children each, so culling visits O(log n) rather than all the CullNodes. 0 keeps the flat list, requires insertCullGroups or insertCullNodes.
+        uint32_t spatialHierarchyLeafSize = 0;
+        SplitMethod spatialHierarchySplitMethod = SplitMethod::SAH;
+
+        // only insert the cull nodes that cullCostModel expects to save more drawing than their culling costs, rather than one for every transform and geometry
+        bool useCullCostModel = false;
+        CullCostModel cullCostModel;
+
+        // order the pipelines, and the descriptor sets and push constants within them, to minimise the cost of the state changes between draws
+        bool sortStateChanges = false;
+        StateChangeCosts stateChangeCosts;
+
+        // count the state changes per frame before and after sorting, into SceneBuilder::unsortedStateChanges and sortedStateChanges
+        bool reportStateChanges = false;
+
+        // when sorting, order the opaque subgraphs that share state front to back from eyePointHint, so nearer subgraphs occlude those behind
+        bool frontToBackHint = false;
+        vsg::dvec3 eyePointHint;
+
+        // number of threads to use when converting textures and compiling shaders, 1 disables threading
+        uint32_t numThreads = 1;
+
+        // pack the materials into a single storage buffer that the built in fbx shaders index with a push constant,
+        // so statesets that only differ by material share descriptor sets
+        bool materialStorageBuffer = false;
+
+        // bind all the textures as one array that the built in fbx shaders index with push constants,
+        // so statesets that only differ by texture share descriptor sets
+        bool bindlessTextures = false;
+
+        // geometries under transforms whose rotation and scale elements are equal when quantised to multiples of matrixTolerance, and
+        // translations when quantised to multiples of matrixTranslationTolerance, share one transform, so transforms that only differ
+        // by round-off are merged. 0 requires the rotation and scale elements to match exactly.
+        double matrixTolerance = 0.0;
+
+        // the tolerance used for the translations of the transforms, which are in scene units rather than relative to 1 like the
+        // rotation and scale elements. 0 requires the translations to match exactly.
+        double matrixTranslationTolerance = 0.0;
+
         GeometryTarget geometryTarget = VSG_VERTEXINDEXDRAW;
 
         uint32_t supportedGeometryAttributes = GeometryAttributes::ALL_ATTS;
@@ -49,6 +166,10 @@ namespace osg2vsg
         vsg::Path extension = "vsgb";
 
         vsg::ref_ptr<PipelineCache> pipelineCache = PipelineCache::create();
+
+        // optional sink for the timings and counters of the conversion phases, nullptr disables the instrumentation.
+        // createVSG(..) passes it on to the pipelineCache and its shaderCompiler.
+        vsg::ref_ptr<Instrumentation> instrumentation;
     };
 
     class SceneBuilderBase
@@ -59,35 +180,54 @@ namespace osg2vsg
         SceneBuilderBase(vsg::ref_ptr<const BuildOptions> options):
             buildOptions(options) {}
 
-        using StateStack = std::vector<osg::ref_ptr<osg::StateSet>>;
-        using StateSets = std::set<StateStack>;
         using StatePair = std::pair<osg::ref_ptr<osg::StateSet>, osg::ref_ptr<osg::StateSet>>;
-        using StateMap = std::map<StateStack, StatePair>;
-        using GeometriesMap = std::map<const osg::Geometry*, vsg::ref_ptr<vsg::Command>>;
+
+        // node of the trie of the StateSet stacks pushed during traversal, memoising the merged StateSet and StatePair of the stack from the root to it
+        struct StateNode
+        {
+            StateNode* parent = nullptr;
+            osg::ref_ptr<osg::StateSet> stateset;
+            uint32_t depth = 0;
+            osg::ref_ptr<osg::StateSet> combined;
+            StatePair statePair;
+            std::unordered_map<const osg::StateSet*, std::unique_ptr<StateNode>> children;
+        };
+        using GeometryKey = std::pair<const osg::Geometry*, uint32_t>; // geometry and the attributes mask it was converted with
+        using GeometriesMap = std::map<GeometryKey, vsg::ref_ptr<vsg::Command>>;
 
 
         using TexturesMap = std::map<const osg::Texture*, vsg::ref_ptr<vsg::DescriptorImage>>;
+        using DescriptorSetKey = std::tuple<const vsg::DescriptorSetLayout*, osg::ref_ptr<const osg::StateSet>, uint32_t, std::vector<const osg::Texture*>>; // layout, stateset or its textures, and the shaderModeMask bits that select descriptors
+        using DescriptorSetMap = std::map<DescriptorSetKey, vsg::ref_ptr<vsg::DescriptorSet>>;
+        using Textures = std::set<const osg::Texture*>;
 
-        struct UniqueStateSet
+        struct UniqueMaterial
         {
-            bool operator() ( const osg::ref_ptr<osg::StateSet>& lhs, const osg::ref_ptr<osg::StateSet>& rhs) const
+            bool operator() ( const osg::ref_ptr<const osg::Material>& lhs, const osg::ref_ptr<const osg::Material>& rhs) const
             {
-                if (!lhs) return true;
-                if (!rhs) return false;
                 return lhs->compare(*rhs)<0;
             }
         };
 
-        using UniqueStats = std::set<osg::ref_ptr<osg::StateSet>, UniqueStateSet>;
+        using MaterialIndices = std::map<osg::ref_ptr<const osg::Material>, uint32_t, UniqueMaterial>;
 
         vsg::ref_ptr<const BuildOptions> buildOptions = BuildOptions::create();
 
         uint32_t nodeShaderModeMasks = ShaderModeMask::NONE;
 
-        StateStack statestack;
-        StateMap stateMap;
-        UniqueStats uniqueStateSets;
+        StateNode rootStateNode;
+        StateNode* currentStateNode = &rootStateNode;
+        UniqueStateSets uniqueStateSets;
         TexturesMap texturesMap;
+        DescriptorSetMap descriptorSetMap;
+        MaterialIndices materialIndices;
+        vsg::ref_ptr<vsg::Descriptor> materialBufferDescriptor;
+        std::vector<vsg::ref_ptr<vsg::PushConstants>> materialIndexPushConstants;
+        std::map<const osg::Texture*, uint32_t> textureIndices;
+        vsg::Descriptors bindlessTextureDescriptors;
+        std::map<std::vector<uint32_t>, vsg::ref_ptr<vsg::PushConstants>> textureIndicesPushConstants;
+        std::map<uint32_t, vsg::ref_ptr<vsg::Descriptor>> defaultDescriptors;
+        vsg::ref_ptr<vsg::Sampler> whiteTextureSampler;
         bool writeToFileProgramAndDataSetSets = false;
 
         osg::ref_ptr<osg::StateSet> uniqueState(osg::ref_ptr<osg::StateSet> stateset, bool programStateSet);
@@ -95,10 +235,127 @@ namespace osg2vsg
         StatePair computeStatePair(osg::StateSet* stateset);
         StatePair& getStatePair();
 
+        // push/pop move the current StateNode through the trie, so the merged state is only computed once for each distinct stack
+        void pushStateSet(osg::StateSet& stateset);
+        void popStateSet();
+        uint32_t stateStackDepth() const { return currentStateNode->depth; }
+
+        osg::StateSet* getCombinedStateSet(StateNode& node);
+
         // core VSG style usage
         vsg::ref_ptr<vsg::DescriptorImage> convertToVsgTexture(const osg::Texture* osgtexture);
 
+        // collect the textures that createVsgStateSet(..) will require for the stateset and shaderModeMask
+        void collectTextures(const osg::StateSet* stateset, uint32_t shaderModeMask, Textures& textures) const;
+
+        // collect the textures in the subgraph that createVsgStateSet(..) may require
+        void collectTextures(osg::Node* node, Textures& textures) const;
+
+        // convert the textures that aren't already in the texturesMap, using buildOptions->numThreads threads
+        void convertTextures(const Textures& textures);
+
+        // sampler shared by all the white textures used for the missing texture maps
+        vsg::ref_ptr<vsg::Sampler> getOrCreateWhiteTextureSampler();
+
+        // default material or white texture used to fill the bindings of the uber shader descriptor set layout that a stateset doesn't provide
+        vsg::ref_ptr<vsg::Descriptor> getOrCreateDefaultDescriptor(uint32_t binding);
+
         vsg::ref_ptr<vsg::DescriptorSet> createVsgStateSet(const vsg::DescriptorSetLayouts& descriptorSetLayouts, const osg::StateSet* stateset, uint32_t shaderModeMask);
+
+        // assign the index of the stateset's material in the material storage buffer, equal materials share an index
+        uint32_t getOrAssignMaterialIndex(const osg::StateSet* stateset);
+
+        // pack the materials assigned an index into the material storage buffer, called once all the materials have been assigned
+        void createMaterialBuffer();
+
+        // push constant that selects the stateset's material in the material storage buffer
+        vsg::ref_ptr<vsg::PushConstants> getOrCreateMaterialIndexPushConstants(const osg::StateSet* stateset);
+
+        // assign the textures their elements in the bindless texture array and fill the array's descriptors, the textures must already be converted
+        void assignTextureIndices(const Textures& textures);
+
+        // push constants that select the stateset's texture maps from the bindless texture array
+        vsg::ref_ptr<vsg::PushConstants> getOrCreateTextureIndicesPushConstants(const osg::StateSet* stateset, uint32_t shaderModeMask);
+
+        // return the descriptor set for the stateset, sharing it between all the pipelines with the same (interned) descriptor set layout
+        vsg::ref_ptr<vsg::DescriptorSet> getOrCreateDescriptorSet(const vsg::DescriptorSetLayouts& descriptorSetLayouts, const osg::StateSet* stateset, uint32_t shaderModeMask);
+    };
+
+    // key used to group geometries by transform, equal keys have the same matrix elements once quantised by the tolerances.
+    // tolerance applies to the rotation/scale and projective elements, translationTolerance to the translation row.
+    struct MatrixKey
+    {
+        MatrixKey(const osg::Matrix& in_matrix, double tolerance = 0.0, double translationTolerance = 0.0) :
+            matrix(in_matrix)
+        {
+            // largest quantised magnitude that llround(..) can return as an int64_t
+            constexpr double maxQuantised = 9.0e18;
+
+            const double* ptr = matrix.ptr();
+            hash = 14695981039346656037ull;
+            for(size_t i=0; i<16; ++i)
+            {
+                double elementTolerance = (i>=12 && i<15) ? translationTolerance : tolerance;
+                double quantised = elementTolerance>0.0 ? ptr[i]/elementTolerance : 0.0;
+                if (elementTolerance>0.0 && std::abs(quantised)<=maxQuantised)
+                {
+                    elements[i] = static_cast<int64_t>(std::llround(quantised));
+                }
+                else
+                {
+                    // elements too large to quantise are compared exactly, flagged so they can't match a quantised value.
+                    // adding 0.0 maps -0.0 to 0.0 so they share a key
+                    double value = ptr[i] + 0.0;
+                    std::memcpy(&elements[i], &value, sizeof(value));
+                    if (elementTolerance>0.0) exactElements |= (1u << i);
+                }
+                hash = (hash ^ static_cast<uint64_t>(elements[i])) * 1099511628211ull;
+            }
+            hash = (hash ^ exactElements) * 1099511628211ull;
+        }
+
+        osg::Matrix matrix; // the matrix the key was created from, not used in comparisons
+        std::array<int64_t, 16> elements;
+        uint32_t exactElements = 0; // elements that have a tolerance but were compared exactly
+        uint64_t hash;
+
+        bool operator == (const MatrixKey& rhs) const { return elements == rhs.elements && exactElements == rhs.exactElements; }
+    };
+
+    struct MatrixKeyHash
+    {
+        size_t operator() (const MatrixKey& key) const { return static_cast<size_t>(key.hash); }
+    };
+
+    // hashed map from MatrixKey to T that iterates in insertion order as (matrix, T) pairs,
+    // the matrix of the first key inserted is used for all the keys equal to it
+    template<typename T>
+    class MatrixMap
+    {
+    public:
+        using value_type = std::pair<osg::Matrix, T>;
+        using iterator = typename std::vector<value_type>::iterator;
+        using const_iterator = typename std::vector<value_type>::const_iterator;
+
+        T& operator[] (const MatrixKey& key)
+        {
+            auto [itr, inserted] = _indices.emplace(key, _entries.size());
+            if (inserted) _entries.emplace_back(key.matrix, T());
+            return _entries[itr->second].second;
+        }
+
+        size_t size() const { return _entries.size(); }
+        bool empty() const { return _entries.empty(); }
+        void clear() { _entries.clear(); _indices.clear(); }
+
+        iterator begin() { return _entries.begin(); }
+        iterator end() { return _entries.end(); }
+        const_iterator begin() const { return _entries.begin(); }
+        const_iterator end() const { return _entries.end(); }
+
+    protected:
+        std::vector<value_type> _entries;
+        std::unordered_map<MatrixKey, size_t, MatrixKeyHash> _indices;
     };
 
     class SceneBuilder : public osg::NodeVisitor, public SceneBuilderBase
@@ -113,24 +370,35 @@ namespace osg2vsg
 
         using Geometries = std::vector<osg::ref_ptr<osg::Geometry>>;
         using StateGeometryMap = std::map<osg::ref_ptr<osg::StateSet>, Geometries>;
-        using TransformGeometryMap = std::map<osg::Matrix, Geometries>;
+        using TransformGeometryMap = MatrixMap<Geometries>;
         using MatrixStack = std::vector<osg::Matrixd>;
 
         struct TransformStatePair
         {
-            std::map<osg::Matrix, StateGeometryMap> matrixStateGeometryMap;
+            MatrixMap<StateGeometryMap> matrixStateGeometryMap;
             std::map<osg::ref_ptr<osg::StateSet>, TransformGeometryMap> stateTransformMap;
         };
 
         using Masks = std::pair<uint32_t, uint32_t>;
         using MasksTransformStateMap = std::map<Masks, TransformStatePair>;
 
+        // compute the shaderModeMask and geometry mask that will be used to build the pipeline for the masks collected during traversal
+        Masks computeBuildMasks(const Masks& masks) const;
+
+        // rekey masksTransformStateMap by the build masks so that mask combinations producing the same pipeline share it
+        void mergeEquivalentPipelines();
+
+        // number of distinct mask combinations collected, and the number of pipelines they were merged into, set by mergeEquivalentPipelines()
+        size_t numRawPipelines = 0;
+        size_t numPipelines = 0;
+
         using ProgramTransformStateMap = std::map<osg::ref_ptr<osg::StateSet>, TransformStatePair>;
 
         MatrixStack matrixstack;
         ProgramTransformStateMap programTransformStateMap;
         MasksTransformStateMap masksTransformStateMap;
         GeometriesMap geometriesMap;
+        BoundsCache boundsCache;
 
         osg::ref_ptr<osg::Node> createStateGeometryGraphOSG(StateGeometryMap& stateGeometryMap);
         osg::ref_ptr<osg::Node> createTransformGeometryGraphOSG(TransformGeometryMap& transformGeometryMap);
@@ -138,6 +406,56 @@ namespace osg2vsg
 
         vsg::ref_ptr<vsg::Node> createTransformGeometryGraphVSG(TransformGeometryMap& transformGeometryMap, vsg::Paths& searchPaths, uint32_t requiredGeomAttributesMask);
 
+        // subgraph that may be placed under a cull node
+        struct CullCandidate
+        {
+            vsg::sphere bound;
+            uint32_t numTriangles;
+            bool cull;
+        };
+        using CullCandidates = std::vector<CullCandidate>;
+
+        // decide which of the cull candidates of a state group get cull nodes using buildOptions->cullCostModel, accumulating cullCostStats
+        void applyCullCostModel(CullCandidates& cullCandidates);
+
+        // expected costs and savings of the cull nodes placed by the last createVSG(..) with buildOptions->useCullCostModel
+        CullCostStats cullCostStats;
+        std::mutex cullCostStatsMutex;
+
+        // subgraph to be placed below its pipeline and descriptor set binds
+        struct StateSubgraph
+        {
+            vsg::ref_ptr<vsg::Group> parent;
+            vsg::ref_ptr<vsg::BindGraphicsPipeline> bindGraphicsPipeline;
+            vsg::ref_ptr<vsg::DescriptorSet> descriptorSet;
+            vsg::ref_ptr<vsg::Node> subgraph;
+            std::vector<const vsg::PushConstants*> pushConstants;
+            bool blend = false;
+            uint32_t numDraws = 0;
+            osg::BoundingSphere bound;
+        };
+        using StateSubgraphs = std::vector<StateSubgraph>;
+
+        // attach the subgraphs to their parents below StateGroups binding their pipeline and descriptor set, grouped by parent (opaque then blended)
+        // and then by pipeline in order of first use. Consecutive subgraphs with the same binds share the StateGroups.
+        void attachStateSubgraphs(const StateSubgraphs& stateSubgraphs) const;
+
+        // count the binds recording the graph makes, when all the subgraphs are drawn
+        StateChangeStats countStateChanges(const vsg::Node& node) const;
+
+        // reorder the subgraphs to minimise the cost of their state changes, see BuildOptions::sortStateChanges
+        void sortStateSubgraphs(StateSubgraphs& stateSubgraphs) const;
+
+        // state changes before and after sorting in the last createVSG(..), when BuildOptions::reportStateChanges is set
+        StateChangeStats unsortedStateChanges;
+        StateChangeStats sortedStateChanges;
+
+        // compile the pipelines required by masksTransformStateMap up front, using buildOptions->numThreads threads
+        void precompilePipelines();
+
+        // convert the geometries in masksTransformStateMap that aren't already in the geometriesMap, using buildOptions->numThreads threads
+        void convertGeometries();
+
         vsg::ref_ptr<vsg::Node> createVSG(vsg::Paths& searchPaths);
 
         void apply(osg::Node& node);
@@ -146,12 +464,19 @@ namespace osg2vsg
         void apply(osg::Billboard& billboard);
         void apply(osg::Geometry& geometry);
 
-        void pushStateSet(osg::StateSet& stateset);
-        void popStateSet();
-
         void pushMatrix(const osg::Matrix& matrix);
         void popMatrix();
 
+        // traverse the subgraph, with buildOptions->numThreads>1 the subgraph is split into independent subgraphs that are traversed in parallel
+        // by separate SceneBuilders, whose maps are then merged in traversal order so the result matches a serial node.accept(*this)
+        void traverseInParallel(osg::Node& node);
+
+        // merge the maps collected by another SceneBuilder, mapping its statesets to the unique statesets of this SceneBuilder
+        void merge(SceneBuilder& builder);
+
+        // set when the billboard geometries have been modified for SHADER_TRANSLATE ahead of the traversal, as traverseInParallel(..) does
+        bool billboardGeometriesPrepared = false;
+
         void print();
     };
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <osg2vsg/Export.h>
+#include <osg2vsg/Instrumentation.h>
 
 #include <vsg/all.h>
 
@@ -23,7 +24,9 @@ namespace osg2vsg
         NORMAL_MAP = 128,
         SPECULAR_MAP = 256,
         SHADER_TRANSLATE = 512,
-        ALL_SHADER_MODE_MASK = LIGHTING | MATERIAL | BLEND | BILLBOARD | DIFFUSE_MAP | OPACITY_MAP | AMBIENT_MAP | NORMAL_MAP | SPECULAR_MAP | SHADER_TRANSLATE
+        MATERIAL_STORAGE_BUFFER = 1024, // material read from a storage buffer of all the materials, indexed by a push constant
+        BINDLESS_TEXTURES = 2048, // texture maps read from an array of all the textures, indexed by push constants
+        ALL_SHADER_MODE_MASK = LIGHTING | MATERIAL | BLEND | BILLBOARD | DIFFUSE_MAP | OPACITY_MAP | AMBIENT_MAP | NORMAL_MAP | SPECULAR_MAP | SHADER_TRANSLATE | MATERIAL_STORAGE_BUFFER | BINDLESS_TEXTURES
     };
 
     // taken from osg fbx plugin
@@ -37,11 +40,58 @@ namespace osg2vsg
         NORMAL_TEXTURE_UNIT,
         SPECULAR_TEXTURE_UNIT,
         SHININESS_TEXTURE_UNIT,
-        MATERIAL_BINDING = 10 // same value as used in the shader
+        MATERIAL_BINDING = 10, // same value as used in the shader
+        BINDLESS_TEXTURE_BINDING = 11 // same value as used in the shader
     };
 
+    // default size of the bindless texture array, the guaranteed maxPerStageDescriptorSamplers. The shader's array is sized by its
+    // constant_id 0 specialization constant, set from PipelineCache::maxBindlessTextures. Element 0 is a white texture used for the maps a stateset doesn't provide.
+    const uint32_t DEFAULT_MAX_BINDLESS_TEXTURES = 16;
+
     extern OSG2VSG_DECLSPEC uint32_t calculateShaderModeMask(const osg::StateSet* stateSet);
 
+    // reduce the shaderModeMask and geometryAttributes to the features that affect the shaders and pipeline, so equivalent combinations share a pipeline.
+    // With builtInShaders the attributes and modes that the built in shaders don't consume in that combination are also removed.
+    extern OSG2VSG_DECLSPEC std::pair<uint32_t, uint32_t> canonicalizeShaderMasks(uint32_t shaderModeMask, uint32_t geometryAttributes, bool builtInShaders);
+
+    // GLSL source parsed once into the #version/#pragma import_defines header lines and the remaining body, so each variant
+    // only needs the #define lines for its imported defines spliced in. #include "file" lines are expanded when parsing,
+    // searching the directory of the including file and then the searchPaths.
+    class OSG2VSG_DECLSPEC ShaderTemplate : public vsg::Inherit<vsg::Object, ShaderTemplate>
+    {
+    public:
+        ShaderTemplate(const std::string& source, const vsg::Path& directory = {}, const vsg::Paths& searchPaths = {});
+
+        // create the source with a #define for each of the defines that are imported by the template
+        std::string createSource(const std::vector<std::string>& defines) const;
+        std::string createSource(const uint32_t& shaderModeMask, const uint32_t& geometryAttrbutes) const;
+
+        // read a template, the parsed templates are cached by path and only reparsed if the file or one of its includes is modified
+        static vsg::ref_ptr<ShaderTemplate> read(const vsg::Path& filename, const vsg::Paths& searchPaths = {});
+
+    protected:
+        struct HeaderLine
+        {
+            std::string text;
+            std::vector<std::string> importedDefines;
+        };
+
+        struct FileStamp
+        {
+            vsg::Path path;
+            int64_t modificationTime;
+            int64_t size;
+        };
+
+        void parse(const std::string& source, const vsg::Path& directory, const vsg::Paths& searchPaths, uint32_t depth);
+        bool upToDate() const;
+
+        std::vector<HeaderLine> _header;
+        std::string _body;
+        size_t _headerSize = 0;
+        std::vector<FileStamp> _dependencies;
+    };
+
     // read a glsl file and inject defines based on shadermodemask and geometryatts
     extern OSG2VSG_DECLSPEC std::string readGLSLShader(const std::string& filename, const uint32_t& shaderModeMask, const uint32_t& geometryAttrbutes);
 
@@ -54,12 +104,98 @@ namespace osg2vsg
     extern OSG2VSG_DECLSPEC std::string createDefaultFragmentSource(const uint32_t& shaderModeMask, const uint32_t& geometryAttrbutes);
 
 
+    // specialization constant ids used by the fbx uber shaders to switch shading features on/off
+    enum UberShaderConstants : uint32_t
+    {
+        LIGHTING_CONSTANT = 0,
+        MATERIAL_CONSTANT,
+        DIFFUSE_MAP_CONSTANT,
+        OPACITY_MAP_CONSTANT,
+        AMBIENT_MAP_CONSTANT,
+        NORMAL_MAP_CONSTANT,
+        SPECULAR_MAP_CONSTANT,
+        BILLBOARD_CONSTANT,
+        NUM_UBER_SHADER_CONSTANTS
+    };
+
+    // create fbx uber shader source, only the geometryAttributes are injected as defines, the shaderModeMask is applied via specialization constants
+    extern OSG2VSG_DECLSPEC std::string createFbxUberVertexSource(const uint32_t& geometryAttrbutes);
+    extern OSG2VSG_DECLSPEC std::string createFbxUberFragmentSource(const uint32_t& geometryAttrbutes);
+
+    // create the specialization constant entries and data that configure the uber shaders for the shaderModeMask
+    extern OSG2VSG_DECLSPEC std::vector<VkSpecializationMapEntry> createUberShaderSpecializationMapEntries();
+    extern OSG2VSG_DECLSPEC vsg::ref_ptr<vsg::uintArray> createUberShaderSpecializationData(const uint32_t& shaderModeMask, const uint32_t& geometryAttrbutes);
+
+    // hash of the shader stage and source used to key the SPIR-V precompiled at build time
+    extern OSG2VSG_DECLSPEC uint64_t hashShaderSource(VkShaderStageFlagBits stage, const std::string& source);
+
+    // look up SPIR-V precompiled at build time for the shader source, returns false if not available (see OSG2VSG_PRECOMPILED_SHADERS CMake option)
+    extern OSG2VSG_DECLSPEC bool getPrecompiledSPIRV(VkShaderStageFlagBits stage, const std::string& source, vsg::ShaderModule::SPIRV& spirv);
+
+
+    // content addressed disk cache of compiled SPIR-V, each entry is stored in directory as a <key>.spv file.
+    // Entries are written to a temporary file and then renamed so reads never see partially written files and need no locking.
+    class OSG2VSG_DECLSPEC ShaderCache : public vsg::Inherit<vsg::Object, ShaderCache>
+    {
+    public:
+        ShaderCache(const vsg::Path& in_directory);
+
+        vsg::Path directory;
+
+        // compute the key from a 128bit hash of the shader stage, the final GLSL source and the compiler settings, including the tool versions
+        static std::string computeKey(VkShaderStageFlagBits stage, const std::string& source, const std::string& settings);
+
+        bool read(const std::string& key, vsg::ShaderModule::SPIRV& spirv) const;
+        bool write(const std::string& key, const vsg::ShaderModule::SPIRV& spirv) const;
+    };
+
+    // optional optimization of the SPIR-V generated by ShaderCompiler
+    struct ShaderOptimizeOptions
+    {
+        enum Preset
+        {
+            NO_PRESET,
+            PERFORMANCE, // glslang's performance oriented SPIRV-Tools passes, these include dead code elimination and constant folding
+            SIZE // glslang's size oriented SPIRV-Tools passes
+        };
+
+        Preset preset = NO_PRESET;
+
+        // individual SPIRV-Tools passes, only available when built against SPIRV-Tools-opt
+        bool deadCodeElimination = false;
+        bool constantFolding = false;
+
+        bool stripDebugInfo = false;
+        bool validate = false;
+
+        // print the size of each compiled shader
+        bool reportSizes = false;
+
+        // true if any setting changes the SPIR-V generated
+        bool changesSPIRV() const { return preset != NO_PRESET || deadCodeElimination || constantFolding || stripDebugInfo; }
+    };
+
     class OSG2VSG_DECLSPEC ShaderCompiler : public vsg::Inherit<vsg::Object, ShaderCompiler>
     {
     public:
         ShaderCompiler(vsg::Allocator* allocator=nullptr);
         virtual ~ShaderCompiler();
 
+        ShaderOptimizeOptions optimizeOptions;
+
+        // optional disk cache, defaults to the directory set by the OSG2VSG_SHADER_CACHE env var if set
+        vsg::ref_ptr<ShaderCache> shaderCache;
+
+        // optional sink for the compile timings and counters
+        vsg::ref_ptr<Instrumentation> instrumentation;
+
+        // string describing the settings that affect the SPIR-V generated, used as part of the ShaderCache key
+        std::string settings() const;
+
         bool compile(vsg::ShaderStages& shaders);
+
+    protected:
+        // run the individual SPIRV-Tools passes selected in optimizeOptions
+        bool optimize(VkShaderStageFlagBits stage, vsg::ShaderModule::SPIRV& spirv);
     };
 }
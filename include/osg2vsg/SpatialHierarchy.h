@@ -0,0 +1,62 @@
+#pragma once
+
+#include <osg2vsg/Export.h>
+
+#include <vsg/all.h>
+
+namespace osg2vsg
+{
+    enum class SplitMethod
+    {
+        MEDIAN, // split at the median node centre along the longest axis
+        SAH // split where the surface area heuristic cost is lowest, over all three axes
+    };
+
+    // subgraph to be placed in a spatial hierarchy, the bound is in the coordinate frame of the hierarchy
+    struct BoundedNode
+    {
+        vsg::sphere bound;
+        vsg::ref_ptr<vsg::Node> node;
+    };
+
+    using BoundedNodes = std::vector<BoundedNode>;
+
+    // estimate of whether culling a subgraph pays for itself, the costs are per frame in units of the cost of drawing a triangle
+    struct OSG2VSG_DECLSPEC CullCostModel
+    {
+        float cullTestCost = 100.0f; // traversing a cull node and testing its bounding sphere against the view frustum
+        float drawCost = 500.0f; // recording a draw and binding its arrays
+        float triangleCost = 1.0f;
+
+        // probability the subgraph is culled while its parent is visible, estimated from its size relative to the parent.
+        // Subgraphs overlapping siblings tend to be culled along with them, so each overlapping sibling reduces the gain from testing it separately.
+        float cullProbability(float radius, float parentRadius, uint32_t numOverlappingSiblings) const;
+
+        // expected draw cost saved by culling the subgraph
+        float expectedDrawSavings(uint32_t numTriangles, float radius, float parentRadius, uint32_t numOverlappingSiblings) const;
+
+        bool requiresCulling(uint32_t numTriangles, float radius, float parentRadius, uint32_t numOverlappingSiblings) const
+        {
+            return expectedDrawSavings(numTriangles, radius, parentRadius, numOverlappingSiblings) > cullTestCost;
+        }
+    };
+
+    // expected per frame costs and savings of the cull nodes placed using a CullCostModel
+    struct OSG2VSG_DECLSPEC CullCostStats
+    {
+        uint32_t numCandidates = 0;
+        uint32_t numCullNodes = 0;
+        double expectedCullCost = 0.0;
+        double expectedDrawSavings = 0.0;
+
+        void add(const CullCostStats& rhs);
+        void print(std::ostream& out) const;
+    };
+
+    // count the other spheres that each sphere overlaps, stopping at maxCount
+    extern OSG2VSG_DECLSPEC std::vector<uint32_t> countOverlaps(const std::vector<vsg::sphere>& spheres, uint32_t maxCount = 16);
+
+    // build a bounding volume hierarchy of nested CullGroups over the nodes, splitting until each CullGroup has no more than leafSize children.
+    // The nodes are added as they are so keep any culling of their own, and the children of each CullGroup keep the order they had in nodes.
+    extern OSG2VSG_DECLSPEC vsg::ref_ptr<vsg::Node> createSpatialHierarchy(const BoundedNodes& nodes, uint32_t leafSize, SplitMethod splitMethod = SplitMethod::SAH);
+}
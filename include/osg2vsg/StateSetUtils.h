@@ -0,0 +1,50 @@
+#pragma once
+
+#include <osg2vsg/Export.h>
+
+#include <osg/StateSet>
+
+#include <unordered_map>
+#include <vector>
+
+namespace osg2vsg
+{
+    // structural hash of the modes, attributes, texture modes, texture attributes, uniforms and defines of a StateSet.
+    // Attributes and uniforms are hashed by pointer to match osg::StateSet::compare(..), so StateSets that compare equal have the same hash.
+    extern OSG2VSG_DECLSPEC uint64_t hashStateSet(const osg::StateSet& stateset);
+
+    // open addressing hash set of StateSets, StateSets with the same hash are checked with osg::StateSet::compare(..)
+    class OSG2VSG_DECLSPEC UniqueStateSets
+    {
+    public:
+        // return the StateSet in the set that is equal to stateset, or nullptr if there isn't one
+        osg::StateSet* find(const osg::StateSet* stateset) const;
+
+        // return the StateSet in the set that is equal to stateset, inserting stateset if there isn't one
+        osg::ref_ptr<osg::StateSet> insert(osg::ref_ptr<osg::StateSet> stateset);
+
+        // hashStateSet(..) of stateset, cached by pointer for the StateSets in the set so they are only hashed once.
+        // The statesets in the set must not be modified until clear() is called.
+        uint64_t hash(const osg::StateSet* stateset) const;
+
+        size_t size() const { return _size; }
+        void clear();
+
+    protected:
+        struct Slot
+        {
+            uint64_t hash = 0;
+            osg::ref_ptr<osg::StateSet> stateset;
+        };
+
+        // index of the slot holding a StateSet equal to stateset, or of the empty slot where it would be inserted
+        size_t findSlot(const osg::StateSet* stateset, uint64_t hash) const;
+        void rehash(size_t capacity);
+
+        std::vector<Slot> _slots;
+        size_t _size = 0;
+
+        // hashes of the StateSets in _slots, which keep them from being deleted and another StateSet allocated at the same address
+        std::unordered_map<const osg::StateSet*, uint64_t> _hashes;
+    };
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <osg2vsg/Export.h>
+
+#include <vsg/all.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+
+namespace osg2vsg
+{
+    // process wide pool of vsg::OperationThreads shared by all the parallelFor calls, created on first use with
+    // max(minNumThreads, std::thread::hardware_concurrency()) threads and closed at exit. A later call with a larger
+    // minNumThreads replaces it with a pool of that size, the old pool is kept until exit for the work already queued on it.
+    extern OSG2VSG_DECLSPEC vsg::ref_ptr<vsg::OperationThreads> getSharedOperationThreads(uint32_t minNumThreads);
+
+    // true on a thread that is running parallelFor's func, nested parallelFor calls run serially rather than queuing more work
+    extern OSG2VSG_DECLSPEC bool& insideParallelFor();
+
+    // call func(index) for each index in the range [0, count), distributing the calls across up to numThreads threads,
+    // the calling thread and numThreads-1 threads of the shared pool. Returns once all the calls have completed, with
+    // numThreads<=1 or when nested in another parallelFor the calls are made serially on the calling thread.
+    // If func throws, the remaining indices are skipped and the first exception is rethrown on the calling thread.
+    template<typename Func>
+    void parallelFor(uint32_t numThreads, size_t count, Func func)
+    {
+        if (count==0) return;
+
+        if (numThreads<=1 || count==1 || insideParallelFor())
+        {
+            for(size_t i=0; i<count; ++i) func(i);
+            return;
+        }
+
+        struct SharedState
+        {
+            SharedState(Func& in_func, size_t in_count) :
+                func(in_func),
+                count(in_count) {}
+
+            Func& func;
+            size_t count;
+            std::atomic<size_t> next{0};
+            std::mutex mutex;
+            std::exception_ptr exception;
+
+            // take indices until none are left, recording the first exception rather than letting it escape the thread
+            void runIndices()
+            {
+                bool previous = insideParallelFor();
+                insideParallelFor() = true;
+
+                for(size_t i = next++; i < count; i = next++)
+                {
+                    try
+                    {
+                        func(i);
+                    }
+                    catch(...)
+                    {
+                        std::lock_guard<std::mutex> guard(mutex);
+                        if (!exception) exception = std::current_exception();
+                        next = count;
+                    }
+                }
+
+                insideParallelFor() = previous;
+            }
+        };
+
+        struct IndicesOperation : public vsg::Operation
+        {
+            IndicesOperation(SharedState& in_state, vsg::ref_ptr<vsg::Latch> in_latch) :
+                state(in_state),
+                latch(in_latch) {}
+
+            void run() override
+            {
+                state.runIndices();
+
+                // signal completion to the thread waiting on the latch
+                latch->count_down();
+            }
+
+            SharedState& state;
+            vsg::ref_ptr<vsg::Latch> latch;
+        };
+
+        SharedState state(func, count);
+
+        // the calling thread takes indices as well, so only numWorkers operations are queued
+        size_t numWorkers = std::min(static_cast<size_t>(numThreads), count) - 1;
+        auto operationThreads = getSharedOperationThreads(numThreads);
+        auto latch = vsg::Latch::create(static_cast<int>(numWorkers));
+
+        for(size_t i=0; i<numWorkers; ++i)
+        {
+            operationThreads->queue->add(vsg::ref_ptr<IndicesOperation>(new IndicesOperation(state, latch)));
+        }
+
+        state.runIndices();
+
+        // wait until the queued operations have completed, they reference state
+        latch->wait();
+
+        if (state.exception) std::rethrow_exception(state.exception);
+    }
+}
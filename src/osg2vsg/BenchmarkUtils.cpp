@@ -0,0 +1,121 @@
+#include <osg2vsg/BenchmarkUtils.h>
+
+#include <osg2vsg/GeometryUtils.h>
+
+#include <osg/Geometry>
+#include <osg/NodeVisitor>
+#include <osg/Texture>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <set>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace osg2vsg;
+
+double osg2vsg::percentile(std::vector<double> values, double fraction)
+{
+    if (values.empty()) return 0.0;
+
+    size_t rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(values.size())));
+    size_t index = std::min(values.size() - 1, rank > 0 ? rank - 1 : 0);
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+TimingSummary osg2vsg::summarizeTimings(const std::vector<double>& times)
+{
+    TimingSummary summary;
+    if (times.empty()) return summary;
+
+    summary.first = times.front();
+    summary.min = *std::min_element(times.begin(), times.end());
+    summary.median = percentile(times, 0.5);
+    summary.p95 = percentile(times, 0.95);
+    summary.mean = std::accumulate(times.begin(), times.end(), 0.0) / static_cast<double>(times.size());
+    return summary;
+}
+
+uint64_t osg2vsg::getPeakResidentSetSize()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    #if defined(__APPLE__)
+    return static_cast<uint64_t>(usage.ru_maxrss); // bytes
+    #else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // kilobytes
+    #endif
+#else
+    return 0;
+#endif
+}
+
+std::atomic<uint64_t>& osg2vsg::allocationCount()
+{
+    static std::atomic<uint64_t> s_allocationCount{0};
+    return s_allocationCount;
+}
+
+namespace
+{
+    class ComputeSceneSize : public osg::NodeVisitor
+    {
+    public:
+        SceneSize size;
+        std::set<const osg::Geometry*> geometries;
+        std::set<const osg::Image*> images;
+
+        ComputeSceneSize() :
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+        void apply(osg::Node& node) override
+        {
+            if (node.getStateSet()) apply(*node.getStateSet());
+            traverse(node);
+        }
+
+        void apply(osg::Geometry& geometry) override
+        {
+            if (geometry.getStateSet()) apply(*geometry.getStateSet());
+
+            if (geometries.insert(&geometry).second)
+            {
+                ++size.geometries;
+                size.triangles += computeNumTriangles(&geometry);
+            }
+        }
+
+        void apply(osg::StateSet& stateset)
+        {
+            for(auto& textureAttributes : stateset.getTextureAttributeList())
+            {
+                for(auto& [type, attributePair] : textureAttributes)
+                {
+                    auto texture = attributePair.first->asTexture();
+                    if (!texture) continue;
+
+                    for(unsigned int i = 0; i < texture->getNumImages(); ++i)
+                    {
+                        auto image = texture->getImage(i);
+                        if (!image || !images.insert(image).second) continue;
+
+                        ++size.textures;
+                        size.texels += static_cast<uint64_t>(image->s()) * image->t() * image->r();
+                    }
+                }
+            }
+        }
+    };
+}
+
+SceneSize osg2vsg::computeSceneSize(osg::Node& node)
+{
+    ComputeSceneSize computeSceneSize;
+    node.accept(computeSceneSize);
+    return computeSceneSize.size;
+}
@@ -0,0 +1,269 @@
+#include <osg2vsg/BoundsUtils.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace osg2vsg;
+
+namespace
+{
+    // eigen decomposition of the symmetric 3x3 matrix a using Jacobi rotations, the eigenvectors are returned as the columns of vectors
+    void computeEigenVectors(double a[3][3], double values[3], double vectors[3][3])
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            for (int j = 0; j < 3; ++j) vectors[i][j] = (i == j) ? 1.0 : 0.0;
+        }
+
+        const int pairs[3][2] = {{0, 1}, {0, 2}, {1, 2}};
+        for (int sweep = 0; sweep < 32; ++sweep)
+        {
+            double offDiagonal = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+            if (offDiagonal < 1e-24) break;
+
+            for (auto& pair : pairs)
+            {
+                int p = pair[0];
+                int q = pair[1];
+                if (std::abs(a[p][q]) < 1e-30) continue;
+
+                double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+                double c = 1.0 / std::sqrt(t * t + 1.0);
+                double s = t * c;
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    double akp = a[k][p], akq = a[k][q];
+                    a[k][p] = c * akp - s * akq;
+                    a[k][q] = s * akp + c * akq;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    double apk = a[p][k], aqk = a[q][k];
+                    a[p][k] = c * apk - s * aqk;
+                    a[q][k] = s * apk + c * aqk;
+                }
+                for (int k = 0; k < 3; ++k)
+                {
+                    double vkp = vectors[k][p], vkq = vectors[k][q];
+                    vectors[k][p] = c * vkp - s * vkq;
+                    vectors[k][q] = s * vkp + c * vkq;
+                }
+            }
+        }
+
+        for (int i = 0; i < 3; ++i) values[i] = a[i][i];
+    }
+
+    float boxVolume(const osg::BoundingBox& bb)
+    {
+        return (bb.xMax() - bb.xMin()) * (bb.yMax() - bb.yMin()) * (bb.zMax() - bb.zMin());
+    }
+}
+
+osg::BoundingSphere osg2vsg::computeRitterSphere(const osg::Vec3Array& vertices)
+{
+    if (vertices.empty()) return osg::BoundingSphere();
+
+    auto farthestFrom = [&](const osg::Vec3& point) {
+        const osg::Vec3* farthest = &vertices.front();
+        float maxDistance2 = 0.0f;
+        for (auto& vertex : vertices)
+        {
+            float distance2 = (vertex - point).length2();
+            if (distance2 > maxDistance2)
+            {
+                maxDistance2 = distance2;
+                farthest = &vertex;
+            }
+        }
+        return *farthest;
+    };
+
+    // initial sphere spanning two points that are roughly the farthest apart, then grow it to include any vertices outside
+    osg::Vec3 y = farthestFrom(vertices.front());
+    osg::Vec3 z = farthestFrom(y);
+
+    osg::Vec3 center = (y + z) * 0.5f;
+    float radius = (z - y).length() * 0.5f;
+
+    for (auto& vertex : vertices)
+    {
+        float distance = (vertex - center).length();
+        if (distance > radius)
+        {
+            float newRadius = (radius + distance) * 0.5f;
+            center += (vertex - center) * ((newRadius - radius) / distance);
+            radius = newRadius;
+        }
+    }
+
+    // allow for the rounding of the incremental updates
+    return osg::BoundingSphere(center, radius * (1.0f + 1e-5f));
+}
+
+OrientedBox osg2vsg::computeOrientedBox(const osg::Vec3Array& vertices)
+{
+    OrientedBox box;
+    if (vertices.empty()) return box;
+
+    osg::Vec3d mean;
+    for (auto& vertex : vertices) mean += osg::Vec3d(vertex);
+    mean /= static_cast<double>(vertices.size());
+
+    double covariance[3][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+    for (auto& vertex : vertices)
+    {
+        osg::Vec3d d = osg::Vec3d(vertex) - mean;
+        for (int i = 0; i < 3; ++i)
+        {
+            for (int j = 0; j < 3; ++j) covariance[i][j] += d[i] * d[j];
+        }
+    }
+
+    double values[3];
+    double vectors[3][3];
+    computeEigenVectors(covariance, values, vectors);
+
+    osg::Vec3 minExtents(FLT_MAX, FLT_MAX, FLT_MAX);
+    osg::Vec3 maxExtents(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (int k = 0; k < 3; ++k)
+    {
+        box.axes[k].set(vectors[0][k], vectors[1][k], vectors[2][k]);
+        box.axes[k].normalize();
+    }
+
+    for (auto& vertex : vertices)
+    {
+        osg::Vec3 d = vertex - osg::Vec3(mean);
+        for (int k = 0; k < 3; ++k)
+        {
+            float extent = d * box.axes[k];
+            minExtents[k] = std::min(minExtents[k], extent);
+            maxExtents[k] = std::max(maxExtents[k], extent);
+        }
+    }
+
+    box.center = osg::Vec3(mean);
+    for (int k = 0; k < 3; ++k)
+    {
+        box.center += box.axes[k] * ((minExtents[k] + maxExtents[k]) * 0.5f);
+        box.halfExtents[k] = (maxExtents[k] - minExtents[k]) * 0.5f;
+    }
+    return box;
+}
+
+osg::BoundingBox osg2vsg::transformBox(const osg::BoundingBox& bb, const osg::Matrix& matrix)
+{
+    if (!bb.valid()) return bb;
+
+    // Arvo's method, each output axis starts from the translation and adds the smaller/larger of each input axis' contribution
+    osg::BoundingBox result;
+    for (int i = 0; i < 3; ++i)
+    {
+        double minValue = matrix(3, i);
+        double maxValue = matrix(3, i);
+        for (int j = 0; j < 3; ++j)
+        {
+            double a = matrix(j, i) * bb._min[j];
+            double b = matrix(j, i) * bb._max[j];
+            minValue += std::min(a, b);
+            maxValue += std::max(a, b);
+        }
+        result._min[i] = minValue;
+        result._max[i] = maxValue;
+    }
+    return result;
+}
+
+osg::BoundingBox osg2vsg::transformBox(const OrientedBox& box, const osg::Matrix& matrix)
+{
+    if (!box.valid()) return osg::BoundingBox();
+
+    osg::Vec3 center = box.center * matrix;
+    osg::Vec3 extents;
+    for (int k = 0; k < 3; ++k)
+    {
+        osg::Vec3 axis = osg::Matrix::transform3x3(box.axes[k] * box.halfExtents[k], matrix);
+        extents += osg::Vec3(std::abs(axis.x()), std::abs(axis.y()), std::abs(axis.z()));
+    }
+    return osg::BoundingBox(center - extents, center + extents);
+}
+
+osg::BoundingSphere osg2vsg::transformSphere(const osg::BoundingSphere& sphere, const osg::Matrix& matrix)
+{
+    if (!sphere.valid()) return sphere;
+
+    // the largest singular value of the upper 3x3 is the square root of the largest eigenvalue of L * transpose(L)
+    double a[3][3];
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            a[i][j] = matrix(i, 0) * matrix(j, 0) + matrix(i, 1) * matrix(j, 1) + matrix(i, 2) * matrix(j, 2);
+        }
+    }
+
+    double values[3];
+    double vectors[3][3];
+    computeEigenVectors(a, values, vectors);
+    double maxScale = std::sqrt(std::max({values[0], values[1], values[2], 0.0}));
+
+    return osg::BoundingSphere(sphere.center() * matrix, static_cast<float>(sphere.radius() * maxScale * (1.0 + 1e-6)));
+}
+
+GeometryBounds BoundsCache::getBounds(osg::Geometry* geometry)
+{
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        if (auto itr = _bounds.find(geometry); itr != _bounds.end()) return itr->second;
+    }
+
+    GeometryBounds bounds;
+    bounds.box = geometry->getBoundingBox();
+    if (bounds.box.valid()) bounds.sphere = osg::BoundingSphere(bounds.box.center(), bounds.box.radius());
+
+    // billboards compute their bounds from their positions with a callback, so only use the vertices when the bounds come from them
+    auto vertices = dynamic_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+    if (vertices && !vertices->empty() && !geometry->getComputeBoundingBoxCallback())
+    {
+        auto ritterSphere = computeRitterSphere(*vertices);
+        if (!bounds.sphere.valid() || ritterSphere.radius() < bounds.sphere.radius()) bounds.sphere = ritterSphere;
+
+        bounds.obb = computeOrientedBox(*vertices);
+        float obbRadius = bounds.obb.halfExtents.length();
+        if (obbRadius < bounds.sphere.radius()) bounds.sphere = osg::BoundingSphere(bounds.obb.center, obbRadius);
+    }
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _bounds.emplace(geometry, bounds);
+    return bounds;
+}
+
+osg::BoundingSphere BoundsCache::computeBound(const std::vector<osg::ref_ptr<osg::Geometry>>& geometries, const osg::Matrix& matrix)
+{
+    // both the transformed spheres and the transformed boxes enclose the geometries, so use whichever gives the smaller sphere
+    osg::BoundingSphere sphere;
+    osg::BoundingBox box;
+    for (auto& geometry : geometries)
+    {
+        auto bounds = getBounds(geometry.get());
+        if (!bounds.box.valid()) continue;
+
+        sphere.expandBy(transformSphere(bounds.sphere, matrix));
+
+        if (bounds.obb.valid() && bounds.obb.volume() < boxVolume(bounds.box)) box.expandBy(transformBox(bounds.obb, matrix));
+        else box.expandBy(transformBox(bounds.box, matrix));
+    }
+
+    if (box.valid() && (!sphere.valid() || box.radius() < sphere.radius())) return osg::BoundingSphere(box.center(), box.radius());
+    return sphere;
+}
+
+void BoundsCache::clear()
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _bounds.clear();
+}
@@ -0,0 +1,57 @@
+#include <osg2vsg/DeviceLimits.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace osg2vsg;
+
+bool osg2vsg::queryDeviceLimits(DeviceLimits& limits)
+{
+    VkApplicationInfo appInfo = {};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = "osg2vsg";
+    appInfo.apiVersion = VK_API_VERSION_1_0;
+
+    VkInstanceCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    createInfo.pApplicationInfo = &appInfo;
+
+    // a temporary instance, the limits are read before the viewer creates its own
+    VkInstance instance = VK_NULL_HANDLE;
+    if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) return false;
+
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    if (deviceCount > 0) vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+    for(size_t i = 0; i < devices.size(); ++i)
+    {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(devices[i], &properties);
+        const VkPhysicalDeviceLimits& deviceLimits = properties.limits;
+
+        // the viewer may pick any of the devices, so the scenes have to fit the smallest of them
+        if (i == 0)
+        {
+            limits.maxPushConstantsSize = deviceLimits.maxPushConstantsSize;
+            limits.maxPerStageDescriptorSamplers = deviceLimits.maxPerStageDescriptorSamplers;
+            limits.maxPerStageDescriptorSampledImages = deviceLimits.maxPerStageDescriptorSampledImages;
+            limits.maxDescriptorSetSamplers = deviceLimits.maxDescriptorSetSamplers;
+            limits.maxDescriptorSetSampledImages = deviceLimits.maxDescriptorSetSampledImages;
+        }
+        else
+        {
+            limits.maxPushConstantsSize = std::min(limits.maxPushConstantsSize, deviceLimits.maxPushConstantsSize);
+            limits.maxPerStageDescriptorSamplers = std::min(limits.maxPerStageDescriptorSamplers, deviceLimits.maxPerStageDescriptorSamplers);
+            limits.maxPerStageDescriptorSampledImages = std::min(limits.maxPerStageDescriptorSampledImages, deviceLimits.maxPerStageDescriptorSampledImages);
+            limits.maxDescriptorSetSamplers = std::min(limits.maxDescriptorSetSamplers, deviceLimits.maxDescriptorSetSamplers);
+            limits.maxDescriptorSetSampledImages = std::min(limits.maxDescriptorSetSampledImages, deviceLimits.maxDescriptorSetSampledImages);
+        }
+    }
+
+    vkDestroyInstance(instance, nullptr);
+
+    return !devices.empty();
+}
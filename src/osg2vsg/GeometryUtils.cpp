@@ -105,6 +105,42 @@ namespace osg2vsg
         }
     }
 
+    static uint32_t computeNumTriangles(GLenum mode, uint32_t numIndices)
+    {
+        switch (mode)
+        {
+            case osg::PrimitiveSet::TRIANGLES: return numIndices / 3;
+            case osg::PrimitiveSet::TRIANGLE_STRIP:
+            case osg::PrimitiveSet::TRIANGLE_FAN:
+            case osg::PrimitiveSet::POLYGON: return numIndices >= 3 ? numIndices - 2 : 0;
+            case osg::PrimitiveSet::QUADS: return (numIndices / 4) * 2;
+            case osg::PrimitiveSet::QUAD_STRIP: return numIndices >= 4 ? ((numIndices - 2) / 2) * 2 : 0;
+            case osg::PrimitiveSet::TRIANGLES_ADJACENCY: return numIndices / 6;
+            case osg::PrimitiveSet::TRIANGLE_STRIP_ADJACENCY: return numIndices >= 6 ? numIndices / 2 - 2 : 0;
+            default: return 0;
+        }
+    }
+
+    uint32_t computeNumTriangles(const osg::Geometry* geometry)
+    {
+        uint32_t numTriangles = 0;
+        if (!geometry) return numTriangles;
+
+        for (auto& primitiveSet : geometry->getPrimitiveSetList())
+        {
+            // DrawArrayLengths holds a strip, fan or polygon per length
+            if (auto drawArrayLengths = dynamic_cast<const osg::DrawArrayLengths*>(primitiveSet.get()))
+            {
+                for (auto length : *drawArrayLengths) numTriangles += computeNumTriangles(primitiveSet->getMode(), length);
+            }
+            else
+            {
+                numTriangles += computeNumTriangles(primitiveSet->getMode(), primitiveSet->getNumIndices());
+            }
+        }
+        return numTriangles;
+    }
+
     uint32_t calculateAttributesMask(const osg::Geometry* geometry)
     {
         uint32_t mask = 0;
@@ -273,7 +309,7 @@ namespace osg2vsg
         return matvalue;
     }
 
-    vsg::ref_ptr<vsg::Command> convertToVsg(osg::Geometry* ingeometry, uint32_t requiredAttributesMask, GeometryTarget geometryTarget)
+    vsg::ref_ptr<vsg::Command> convertToVsg(osg::Geometry* ingeometry, uint32_t requiredAttributesMask, GeometryTarget geometryTarget, Instrumentation* instrumentation)
     {
         uint32_t instanceCount = 1;
 
@@ -297,17 +333,21 @@ namespace osg2vsg
         uint32_t bindOverallPaddingCount = instanceCount;
 
 
-        // convert attribute arrays, create defaults for any requested that don't exist for now to ensure pipline gets required data
+        // convert the attribute arrays the pipeline requires, create defaults for any requested that don't exist for now to ensure pipline gets required data
         vsg::ref_ptr<vsg::Data> vertices(osg2vsg::convertToVsg(ingeometry->getVertexArray(), bindOverallPaddingCount));
         if (!vertices.valid() || vertices->valueCount() == 0) return vsg::ref_ptr<vsg::Geometry>();
 
         // normals
-        vsg::ref_ptr<vsg::Data> normals(osg2vsg::convertToVsg(ingeometry->getNormalArray(), bindOverallPaddingCount));
+        vsg::ref_ptr<vsg::Data> normals;
+        if (requiredAttributesMask & NORMAL) normals = osg2vsg::convertToVsg(ingeometry->getNormalArray(), bindOverallPaddingCount);
 
         // tangents
-        vsg::ref_ptr<vsg::Data> tangents(osg2vsg::convertToVsg(ingeometry->getVertexAttribArray(6), bindOverallPaddingCount));
+        vsg::ref_ptr<vsg::Data> tangents;
+        if (requiredAttributesMask & TANGENT) tangents = osg2vsg::convertToVsg(ingeometry->getVertexAttribArray(6), bindOverallPaddingCount);
         if ((!tangents.valid() || tangents->valueCount() == 0) && (requiredAttributesMask & TANGENT))
         {
+            ScopedTiming timing(instrumentation, "tangent generation");
+
             osg::ref_ptr<osgUtil::TangentSpaceGenerator> tangentSpaceGenerator = new osgUtil::TangentSpaceGenerator();
             tangentSpaceGenerator->generate(ingeometry, 0);
 
@@ -324,12 +364,15 @@ namespace osg2vsg
         }
 
         // colors
-        vsg::ref_ptr<vsg::Data> colors(osg2vsg::convertToVsg(ingeometry->getColorArray(), bindOverallPaddingCount));
+        vsg::ref_ptr<vsg::Data> colors;
+        if (requiredAttributesMask & COLOR) colors = osg2vsg::convertToVsg(ingeometry->getColorArray(), bindOverallPaddingCount);
 
         // tex0
-        vsg::ref_ptr<vsg::Data> texcoord0(osg2vsg::convertToVsg(ingeometry->getTexCoordArray(0), bindOverallPaddingCount));
+        vsg::ref_ptr<vsg::Data> texcoord0;
+        if (requiredAttributesMask & TEXCOORD0) texcoord0 = osg2vsg::convertToVsg(ingeometry->getTexCoordArray(0), bindOverallPaddingCount);
 
-        vsg::ref_ptr<vsg::Data> translations(osg2vsg::convertToVsg(ingeometry->getVertexAttribArray(7), bindOverallPaddingCount));
+        vsg::ref_ptr<vsg::Data> translations;
+        if (requiredAttributesMask & TRANSLATE) translations = osg2vsg::convertToVsg(ingeometry->getVertexAttribArray(7), bindOverallPaddingCount);
 
         // fill arrays data list THE ORDER HERE IS IMPORTANT
         auto attributeArrays = vsg::DataList{ vertices }; // always have verticies
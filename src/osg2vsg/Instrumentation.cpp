@@ -0,0 +1,141 @@
+#include <osg2vsg/Instrumentation.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace osg2vsg;
+
+RecordingInstrumentation::RecordingInstrumentation() :
+    _origin(clock::now())
+{
+}
+
+uint32_t RecordingInstrumentation::threadIndex()
+{
+    // small indices in order of first use are easier to read in the trace viewers than the native thread ids
+    auto [itr, inserted] = _threadIndices.emplace(std::this_thread::get_id(), static_cast<uint32_t>(_threadIndices.size()));
+    return itr->second;
+}
+
+void RecordingInstrumentation::timing(const char* name, clock::time_point start, clock::time_point end)
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _events.push_back(Event{name, threadIndex(), start, end, 0, false});
+}
+
+void RecordingInstrumentation::counter(const char* name, int64_t value)
+{
+    auto now = clock::now();
+
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _events.push_back(Event{name, threadIndex(), now, now, value, true});
+}
+
+void RecordingInstrumentation::clear()
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+    _events.clear();
+    _origin = clock::now();
+}
+
+static double microseconds(Instrumentation::clock::duration duration)
+{
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+void RecordingInstrumentation::writeChromeTrace(std::ostream& out) const
+{
+    std::scoped_lock<std::mutex> lock(_mutex);
+
+    // counters are accumulated so the trace shows their running totals
+    std::map<std::string, int64_t> totals;
+
+    out<<"{\"traceEvents\": [";
+    bool first = true;
+    for(auto& event : _events)
+    {
+        out<<(first ? "\n" : ",\n");
+        first = false;
+
+        if (event.isCounter)
+        {
+            auto& total = totals[event.name];
+            total += event.value;
+            out<<"  {\"name\": \""<<event.name<<"\", \"ph\": \"C\", \"ts\": "<<microseconds(event.start - _origin)<<", \"pid\": 0, \"args\": {\"value\": "<<total<<"}}";
+        }
+        else
+        {
+            out<<"  {\"name\": \""<<event.name<<"\", \"ph\": \"X\", \"ts\": "<<microseconds(event.start - _origin)<<", \"dur\": "<<microseconds(event.end - event.start)
+               <<", \"pid\": 0, \"tid\": "<<event.thread<<"}";
+        }
+    }
+    out<<"\n], \"displayTimeUnit\": \"ms\"}"<<std::endl;
+}
+
+void RecordingInstrumentation::printSummary(std::ostream& out) const
+{
+    struct Timing
+    {
+        uint32_t count = 0;
+        double total = 0.0;
+        double max = 0.0;
+    };
+
+    // keep the phases in the order they first ran
+    std::vector<const char*> timingNames;
+    std::map<std::string, Timing> timings;
+    std::vector<const char*> counterNames;
+    std::map<std::string, int64_t> counters;
+
+    {
+        std::scoped_lock<std::mutex> lock(_mutex);
+        for(auto& event : _events)
+        {
+            if (event.isCounter)
+            {
+                auto [itr, inserted] = counters.try_emplace(event.name, 0);
+                if (inserted) counterNames.push_back(event.name);
+                itr->second += event.value;
+            }
+            else
+            {
+                auto [itr, inserted] = timings.try_emplace(event.name);
+                if (inserted) timingNames.push_back(event.name);
+
+                double duration = std::chrono::duration<double, std::milli>(event.end - event.start).count();
+                auto& timing = itr->second;
+                ++timing.count;
+                timing.total += duration;
+                timing.max = std::max(timing.max, duration);
+            }
+        }
+    }
+
+    size_t longestName = strlen("phase");
+    for(auto name : timingNames) longestName = std::max(strlen(name), longestName);
+    for(auto name : counterNames) longestName = std::max(strlen(name), longestName);
+
+    out<<"\nTimings:\n";
+    out<<"    phase";
+    for(size_t i = strlen("phase"); i<longestName; ++i) out<<" ";
+    out<<"\tCount\tTotal ms\tMean ms\tMax ms\n";
+    for(auto name : timingNames)
+    {
+        auto& timing = timings[name];
+        out<<"    "<<name;
+        for(size_t i = strlen(name); i<longestName; ++i) out<<" ";
+        out<<"\t"<<timing.count<<"\t"<<timing.total<<"\t"<<(timing.total / timing.count)<<"\t"<<timing.max<<"\n";
+    }
+
+    if (!counterNames.empty())
+    {
+        out<<"\nCounters:\n";
+        for(auto name : counterNames)
+        {
+            out<<"    "<<name;
+            for(size_t i = strlen(name); i<longestName; ++i) out<<" ";
+            out<<"\t"<<counters[name]<<"\n";
+        }
+    }
+    out<<std::endl;
+}
@@ -9,6 +9,9 @@
 #include <vsg/nodes/CullNode.h>
 
 #include <osg/io_utils>
+#include <osg/Version>
+#include <osgUtil/MeshOptimizers>
+#include <osgUtil/Optimizer>
 
 using namespace osg2vsg;
 
@@ -151,3 +154,28 @@ void OptimizeOsgBillboards::optimize()
     }
 
 }
+
+void osg2vsg::optimizeOsgScene(osg::Node* scene)
+{
+    osgUtil::IndexMeshVisitor imv;
+    #if OSG_MIN_VERSION_REQUIRED(3,6,4)
+    imv.setGenerateNewIndicesOnAllGeometries(true);
+    #endif
+    scene->accept(imv);
+    imv.makeMesh();
+
+    osgUtil::VertexCacheVisitor vcv;
+    scene->accept(vcv);
+    vcv.optimizeVertices();
+
+    osgUtil::VertexAccessOrderVisitor vaov;
+    scene->accept(vaov);
+    vaov.optimizeOrder();
+
+    osgUtil::Optimizer optimizer;
+    optimizer.optimize(scene, osgUtil::Optimizer::DEFAULT_OPTIMIZATIONS);
+
+    OptimizeOsgBillboards optimizeBillboards;
+    scene->accept(optimizeBillboards);
+    optimizeBillboards.optimize();
+}
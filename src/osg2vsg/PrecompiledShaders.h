@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+// table of SPIR-V compiled at build time by the precompile_shaders tool, the definitions are generated into PrecompiledShaders.cpp in the build directory
+namespace osg2vsg::precompiled
+{
+    struct Entry
+    {
+        uint64_t key; // hashShaderSource(stage, source)
+        uint32_t offset; // offset into words
+        uint32_t size; // number of 32bit words
+    };
+
+    // sorted by key
+    extern const Entry entries[];
+    extern const uint32_t numEntries;
+
+    extern const uint32_t words[];
+}
@@ -0,0 +1,360 @@
+#include <osg2vsg/RecordSimulator.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace osg2vsg;
+
+namespace
+{
+    struct Counter
+    {
+        const char* name;
+        uint64_t RecordStats::* value;
+    };
+
+    const Counter s_counters[] = {
+        {"pipelineBinds", &RecordStats::pipelineBinds},
+        {"descriptorSetBinds", &RecordStats::descriptorSetBinds},
+        {"pushConstants", &RecordStats::pushConstants},
+        {"vertexBufferBinds", &RecordStats::vertexBufferBinds},
+        {"indexBufferBinds", &RecordStats::indexBufferBinds},
+        {"draws", &RecordStats::draws},
+        {"triangles", &RecordStats::triangles},
+        {"culledNodes", &RecordStats::culledNodes},
+        {"redundantBinds", &RecordStats::redundantBinds}
+    };
+}
+
+double RecordStats::cost(const StateChangeCosts& costs) const
+{
+    return costs.pipeline * pipelineBinds + costs.descriptorSet * descriptorSetBinds + costs.vertexBuffers * vertexBufferBinds + costs.pushConstants * pushConstants;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+//
+// RecordSimulator
+//
+RecordSimulator::RecordSimulator(const RecordCamera& camera, const vsg::dmat4& viewMatrix) :
+    _camera(camera)
+{
+    const double pi = 3.14159265358979323846;
+    _tanHalfFieldOfViewY = std::tan(camera.fieldOfViewY * pi / 360.0);
+    _tanHalfFieldOfViewX = _tanHalfFieldOfViewY * camera.aspectRatio;
+    _projectionScale = 1.0 / _tanHalfFieldOfViewY;
+    _modelviewStack.push_back(viewMatrix);
+}
+
+template<typename T>
+double RecordSimulator::eyeDistance(const vsg::t_sphere<T>& sphere) const
+{
+    auto& mv = _modelviewStack.back();
+    return -(mv[0][2] * sphere.center.x + mv[1][2] * sphere.center.y + mv[2][2] * sphere.center.z + mv[3][2]);
+}
+
+double RecordSimulator::modelviewScale() const
+{
+    // the largest of the lengths of the columns of the upper 3x3, so spheres transformed by a non uniform scale are enclosed
+    auto& mv = _modelviewStack.back();
+    double scale = 0.0;
+    for(int c = 0; c < 3; ++c)
+    {
+        scale = std::max(scale, std::sqrt(mv[c][0] * mv[c][0] + mv[c][1] * mv[c][1] + mv[c][2] * mv[c][2]));
+    }
+    return scale;
+}
+
+template<typename T>
+bool RecordSimulator::intersect(const vsg::t_sphere<T>& sphere) const
+{
+    auto& mv = _modelviewStack.back();
+    double x = mv[0][0] * sphere.center.x + mv[1][0] * sphere.center.y + mv[2][0] * sphere.center.z + mv[3][0];
+    double y = mv[0][1] * sphere.center.x + mv[1][1] * sphere.center.y + mv[2][1] * sphere.center.z + mv[3][1];
+    double distance = eyeDistance(sphere);
+    double radius = sphere.radius * modelviewScale();
+
+    if (distance + radius < _camera.nearDistance || distance - radius > _camera.farDistance) return false;
+
+    // distances to the side planes, which pass through the eye point
+    double sideScaleX = 1.0 / std::sqrt(1.0 + _tanHalfFieldOfViewX * _tanHalfFieldOfViewX);
+    double sideScaleY = 1.0 / std::sqrt(1.0 + _tanHalfFieldOfViewY * _tanHalfFieldOfViewY);
+    if ((distance * _tanHalfFieldOfViewX - x) * sideScaleX < -radius) return false;
+    if ((distance * _tanHalfFieldOfViewX + x) * sideScaleX < -radius) return false;
+    if ((distance * _tanHalfFieldOfViewY - y) * sideScaleY < -radius) return false;
+    if ((distance * _tanHalfFieldOfViewY + y) * sideScaleY < -radius) return false;
+
+    return true;
+}
+
+void RecordSimulator::dispatch()
+{
+    uint64_t* binds[NUM_STATE_CATEGORIES] = {&stats.pipelineBinds, &stats.descriptorSetBinds, &stats.pushConstants, nullptr};
+
+    for(int category = 0; category < NUM_STATE_CATEGORIES; ++category)
+    {
+        auto& stateStack = _stateStacks[category];
+        if (stateStack.dirty && !stateStack.stack.empty())
+        {
+            auto& top = stateStack.stack.back();
+            if (binds[category])
+            {
+                *binds[category] += top.size();
+                if (top == stateStack.bound) stats.redundantBinds += top.size();
+            }
+            stateStack.bound = top;
+        }
+        stateStack.dirty = false;
+    }
+}
+
+void RecordSimulator::draw(const vsg::Object& command)
+{
+    if (auto drawIndexed = dynamic_cast<const vsg::DrawIndexed*>(&command))
+    {
+        dispatch();
+        ++stats.draws;
+        stats.triangles += static_cast<uint64_t>(drawIndexed->indexCount / 3) * drawIndexed->instanceCount;
+    }
+    else if (auto drawArrays = dynamic_cast<const vsg::Draw*>(&command))
+    {
+        dispatch();
+        ++stats.draws;
+        stats.triangles += static_cast<uint64_t>(drawArrays->vertexCount / 3) * drawArrays->instanceCount;
+    }
+}
+
+void RecordSimulator::apply(const vsg::Object& object)
+{
+    // the draw commands of vsg::Commands subgraphs
+    draw(object);
+
+    object.traverse(*this);
+}
+
+void RecordSimulator::apply(const vsg::StateGroup& stategroup)
+{
+    StateCommands commands[NUM_STATE_CATEGORIES];
+    for(auto& command : stategroup.getStateCommands())
+    {
+        auto object = static_cast<const vsg::Object*>(command.get());
+        if (dynamic_cast<const vsg::BindGraphicsPipeline*>(object)) commands[PIPELINE].push_back(object);
+        else if (dynamic_cast<const vsg::BindDescriptorSet*>(object) || dynamic_cast<const vsg::BindDescriptorSets*>(object)) commands[DESCRIPTOR_SETS].push_back(object);
+        else if (dynamic_cast<const vsg::PushConstants*>(object)) commands[PUSH_CONSTANTS].push_back(object);
+        else commands[OTHER_STATE].push_back(object);
+    }
+
+    for(int category = 0; category < NUM_STATE_CATEGORIES; ++category)
+    {
+        if (commands[category].empty()) continue;
+        _stateStacks[category].stack.push_back(commands[category]);
+        _stateStacks[category].dirty = true;
+    }
+
+    stategroup.traverse(*this);
+
+    for(int category = 0; category < NUM_STATE_CATEGORIES; ++category)
+    {
+        if (commands[category].empty()) continue;
+        _stateStacks[category].stack.pop_back();
+        _stateStacks[category].dirty = true;
+    }
+}
+
+void RecordSimulator::apply(const vsg::MatrixTransform& transform)
+{
+    // copy element by element so the transform's matrix can be single or double precision
+    auto& matrix = transform.getMatrix();
+    vsg::dmat4 dmatrix;
+    for(int c = 0; c < 4; ++c)
+    {
+        for(int r = 0; r < 4; ++r) dmatrix[c][r] = static_cast<double>(matrix[c][r]);
+    }
+
+    _modelviewStack.push_back(_modelviewStack.back() * dmatrix);
+
+    transform.traverse(*this);
+
+    _modelviewStack.pop_back();
+}
+
+void RecordSimulator::apply(const vsg::CullGroup& cullGroup)
+{
+    if (intersect(cullGroup.getBound())) cullGroup.traverse(*this);
+    else ++stats.culledNodes;
+}
+
+void RecordSimulator::apply(const vsg::CullNode& cullNode)
+{
+    if (intersect(cullNode.getBound())) cullNode.traverse(*this);
+    else ++stats.culledNodes;
+}
+
+void RecordSimulator::apply(const vsg::LOD& lod)
+{
+    auto& bound = lod.getBound();
+    if (!intersect(bound))
+    {
+        ++stats.culledNodes;
+        return;
+    }
+
+    // the first child whose minimum screen height ratio the bound exceeds is traversed
+    double cutoffScale = std::abs(eyeDistance(bound));
+    double screenHeight = bound.radius * modelviewScale() * _projectionScale;
+    for(auto& child : lod.getChildren())
+    {
+        if (screenHeight > cutoffScale * child.minimumScreenHeightRatio)
+        {
+            if (child.child) child.child->accept(*this);
+            return;
+        }
+    }
+}
+
+void RecordSimulator::apply(const vsg::PagedLOD& plod)
+{
+    auto& bound = plod.getBound();
+    if (!intersect(bound))
+    {
+        ++stats.culledNodes;
+        return;
+    }
+
+    // the high resolution child is used when it's selected and loaded, otherwise the low resolution child
+    double cutoffScale = std::abs(eyeDistance(bound));
+    double screenHeight = bound.radius * modelviewScale() * _projectionScale;
+    for(size_t i = 0; i < 2; ++i)
+    {
+        auto& child = plod.getChild(i);
+        if (screenHeight > cutoffScale * child.minimumScreenHeightRatio && child.node)
+        {
+            child.node->accept(*this);
+            return;
+        }
+    }
+}
+
+void RecordSimulator::apply(const vsg::Geometry& geometry)
+{
+    dispatch();
+
+    if (!geometry._arrays.empty()) ++stats.vertexBufferBinds;
+    if (geometry._indices) ++stats.indexBufferBinds;
+
+    for(auto& command : geometry._commands)
+    {
+        draw(*command);
+    }
+}
+
+void RecordSimulator::apply(const vsg::VertexIndexDraw& vid)
+{
+    dispatch();
+
+    if (!vid._arrays.empty()) ++stats.vertexBufferBinds;
+    if (vid._indices) ++stats.indexBufferBinds;
+
+    ++stats.draws;
+    stats.triangles += static_cast<uint64_t>(vid.indexCount / 3) * vid.instanceCount;
+}
+
+void RecordSimulator::apply(const vsg::BindVertexBuffers& /*bvb*/)
+{
+    ++stats.vertexBufferBinds;
+}
+
+void RecordSimulator::apply(const vsg::BindIndexBuffer& /*bib*/)
+{
+    ++stats.indexBufferBinds;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+//
+// RecordSimulation
+//
+void RecordSimulation::run(const vsg::Node& scene, const osg::AnimationPath& path)
+{
+    frames.clear();
+
+    double period = path.getPeriod();
+    uint32_t numFrames = std::max(1u, static_cast<uint32_t>(std::floor(period * frameRate)));
+    for(uint32_t frame = 0; frame < numFrames; ++frame)
+    {
+        // the path positions the camera, its inverse is the view matrix
+        osg::Matrixd matrix;
+        path.getInverse(static_cast<double>(frame) / frameRate, matrix);
+
+        vsg::dmat4 viewMatrix(matrix(0, 0), matrix(0, 1), matrix(0, 2), matrix(0, 3),
+                              matrix(1, 0), matrix(1, 1), matrix(1, 2), matrix(1, 3),
+                              matrix(2, 0), matrix(2, 1), matrix(2, 2), matrix(2, 3),
+                              matrix(3, 0), matrix(3, 1), matrix(3, 2), matrix(3, 3));
+
+        RecordSimulator recordSimulator(camera, viewMatrix);
+        scene.accept(recordSimulator);
+        frames.push_back(recordSimulator.stats);
+    }
+}
+
+void RecordSimulation::print(std::ostream& out, const StateChangeCosts& costs) const
+{
+    if (frames.empty()) return;
+
+    out<<"\nRecord simulation of "<<frames.size()<<" frames\n";
+    out<<"    counter           \tMin per frame\tMean per frame\tMax per frame\n";
+    for(auto& counter : s_counters)
+    {
+        uint64_t minimum = frames.front().*counter.value;
+        uint64_t maximum = minimum;
+        double total = 0.0;
+        for(auto& frame : frames)
+        {
+            minimum = std::min(minimum, frame.*counter.value);
+            maximum = std::max(maximum, frame.*counter.value);
+            total += static_cast<double>(frame.*counter.value);
+        }
+
+        out<<"    "<<counter.name;
+        for(size_t i = strlen(counter.name); i < strlen("counter           "); ++i) out<<" ";
+        out<<"\t"<<minimum<<"\t"<<total / static_cast<double>(frames.size())<<"\t"<<maximum<<"\n";
+    }
+
+    double totalCost = 0.0;
+    for(auto& frame : frames) totalCost += frame.cost(costs);
+    out<<"Mean state change cost per frame "<<totalCost / static_cast<double>(frames.size())<<std::endl;
+}
+
+void RecordSimulation::writeJSON(std::ostream& out, const StateChangeCosts& costs) const
+{
+    out<<"{\n";
+    out<<"  \"frameRate\": "<<frameRate<<",\n";
+    out<<"  \"frames\": [";
+    for(size_t i = 0; i < frames.size(); ++i)
+    {
+        auto& frame = frames[i];
+        out<<(i > 0 ? ",\n" : "\n")<<"    {\"time\": "<<static_cast<double>(i) / frameRate;
+        for(auto& counter : s_counters) out<<", \""<<counter.name<<"\": "<<frame.*counter.value;
+        out<<", \"cost\": "<<frame.cost(costs)<<"}";
+    }
+    out<<"\n  ]\n";
+    out<<"}"<<std::endl;
+}
+
+RecordCamera osg2vsg::createRecordCamera(vsg::Node& scene, double aspectRatio)
+{
+    RecordCamera camera;
+    camera.aspectRatio = aspectRatio;
+
+    // an empty scene has invalid bounds, so keep the default near and far distances
+    vsg::ComputeBounds computeBounds;
+    scene.accept(computeBounds);
+    if (!computeBounds.bounds.valid()) return camera;
+
+    double radius = vsg::length(computeBounds.bounds.max - computeBounds.bounds.min) * 0.6;
+    if (radius <= 0.0) return camera;
+
+    double nearFarRatio = 0.0001;
+    camera.nearDistance = nearFarRatio * radius;
+    camera.farDistance = radius * 4.5;
+    return camera;
+}
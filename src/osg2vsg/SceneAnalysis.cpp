@@ -1,5 +1,7 @@
 #include <osg2vsg/SceneAnalysis.h>
 
+#include <algorithm>
+#include <cmath>
 
 using namespace osg2vsg;
 
@@ -182,3 +184,282 @@ void VsgSceneAnalysis::apply(const vsg::Commands& commands) override
 }
 #endif
 
+
+///////////////////////////////////////////////////////////////////////////////////
+//
+// MemoryStats
+//
+static const char* s_categoryNames[MemoryStats::NUM_CATEGORIES] = {"vertexData", "indexData", "textureData", "uniformData"};
+
+void MemoryStats::insert(Category category, const vsg::Data* data, uint64_t bytes, const vsg::BindGraphicsPipeline* pipeline)
+{
+    if (!data) return;
+
+    auto& entry = dataEntries[category][data];
+    entry.bytes = bytes;
+    ++entry.references;
+
+    if (pipelineStats.find(pipeline) == pipelineStats.end()) pipelines.push_back(pipeline);
+
+    auto& stats = pipelineStats[pipeline];
+    if (stats.data.insert(data).second) stats.bytes[category] += bytes;
+}
+
+MemoryStats::Summary MemoryStats::summarize(Category category) const
+{
+    Summary summary;
+    for(auto& [data, entry] : dataEntries[category])
+    {
+        ++summary.objects;
+        summary.bytes += entry.bytes;
+        summary.referencedBytes += entry.bytes * entry.references;
+        if (entry.references > 1)
+        {
+            ++summary.sharedObjects;
+            summary.sharedBytes += entry.bytes;
+        }
+    }
+    return summary;
+}
+
+uint64_t MemoryStats::totalBytes() const
+{
+    uint64_t total = 0;
+    for(int category = 0; category < NUM_CATEGORIES; ++category) total += summarize(static_cast<Category>(category)).bytes;
+    return total;
+}
+
+void MemoryStats::print(std::ostream& out) const
+{
+    out<<"MemoryStats total bytes: "<<totalBytes()<<"\n";
+    out<<"    category   \tObjects\tBytes\tShared objects\tShared bytes\tReferenced bytes\n";
+    for(int category = 0; category < NUM_CATEGORIES; ++category)
+    {
+        auto summary = summarize(static_cast<Category>(category));
+        out<<"    "<<s_categoryNames[category];
+        for(size_t i = strlen(s_categoryNames[category]); i<strlen("category   "); ++i) out<<" ";
+        out<<"\t"<<summary.objects<<"\t"<<summary.bytes<<"\t"<<summary.sharedObjects<<"\t"<<summary.sharedBytes<<"\t"<<summary.referencedBytes<<"\n";
+    }
+
+    out<<"\nDescriptor sets "<<descriptorSets.size()<<", descriptors "<<numDescriptors<<", pipelines "<<std::count_if(pipelines.begin(), pipelines.end(), [](auto pipeline) { return pipeline != nullptr; })<<"\n";
+
+    out<<"\nPer pipeline:\n";
+    out<<"    pipeline\tDescriptor sets\tDraws\tVertex bytes\tIndex bytes\tTexture bytes\tUniform bytes\n";
+    size_t index = 0;
+    for(auto pipeline : pipelines)
+    {
+        auto& stats = pipelineStats.at(pipeline);
+        if (pipeline) out<<"    "<<index++;
+        else out<<"    none";
+        out<<"\t"<<stats.descriptorSets.size()<<"\t"<<stats.draws;
+        for(auto bytes : stats.bytes) out<<"\t"<<bytes;
+        out<<"\n";
+    }
+    out<<std::endl;
+}
+
+void MemoryStats::writeJSON(std::ostream& out) const
+{
+    out<<"{\n";
+    out<<"  \"totalBytes\": "<<totalBytes()<<",\n";
+    for(int category = 0; category < NUM_CATEGORIES; ++category)
+    {
+        auto summary = summarize(static_cast<Category>(category));
+        out<<"  \""<<s_categoryNames[category]<<"\": {\"objects\": "<<summary.objects<<", \"bytes\": "<<summary.bytes
+           <<", \"sharedObjects\": "<<summary.sharedObjects<<", \"sharedBytes\": "<<summary.sharedBytes
+           <<", \"referencedBytes\": "<<summary.referencedBytes<<"},\n";
+    }
+    out<<"  \"descriptorSets\": "<<descriptorSets.size()<<",\n";
+    out<<"  \"descriptors\": "<<numDescriptors<<",\n";
+    out<<"  \"pipelines\": [";
+
+    size_t index = 0;
+    bool first = true;
+    for(auto pipeline : pipelines)
+    {
+        auto& stats = pipelineStats.at(pipeline);
+        out<<(first ? "\n" : ",\n")<<"    {\"pipeline\": ";
+        if (pipeline) out<<index++;
+        else out<<"null";
+        out<<", \"descriptorSets\": "<<stats.descriptorSets.size()<<", \"draws\": "<<stats.draws;
+        for(int category = 0; category < NUM_CATEGORIES; ++category) out<<", \""<<s_categoryNames[category]<<"Bytes\": "<<stats.bytes[category];
+        out<<"}";
+        first = false;
+    }
+    out<<"\n  ]\n}"<<std::endl;
+}
+
+uint64_t osg2vsg::computeImageBytes(const vsg::Data& data, const vsg::Sampler* sampler)
+{
+    // compressed data is stored as blocks, so scale back up to texels to compute the size of each mip level
+    auto layout = data.getLayout();
+    uint32_t blockWidth = std::max(1u, static_cast<uint32_t>(layout.blockWidth));
+    uint32_t blockHeight = std::max(1u, static_cast<uint32_t>(layout.blockHeight));
+    uint32_t blockDepth = std::max(1u, static_cast<uint32_t>(layout.blockDepth));
+
+    uint32_t width = data.width() * blockWidth;
+    uint32_t height = data.height() * blockHeight;
+    uint32_t depth = data.depth() * blockDepth;
+
+    uint32_t maxDimension = std::max({width, height, depth, 1u});
+    uint32_t fullChain = static_cast<uint32_t>(std::floor(std::log2(maxDimension))) + 1;
+
+    // the mip levels are either generated or copied up to those the sampler can access
+    uint32_t numLevels = std::max(1u, static_cast<uint32_t>(layout.maxNumMipmaps));
+    if (sampler) numLevels = static_cast<uint32_t>(std::floor(std::max(sampler->info().maxLod, 0.0f))) + 1; // levels 0 to floor(maxLod) are accessible
+    numLevels = std::min(std::max(numLevels, 1u), fullChain);
+
+    uint64_t bytes = 0;
+    for(uint32_t level = 0; level < numLevels; ++level)
+    {
+        uint64_t blocksWide = (std::max(1u, width >> level) + blockWidth - 1) / blockWidth;
+        uint64_t blocksHigh = (std::max(1u, height >> level) + blockHeight - 1) / blockHeight;
+        uint64_t blocksDeep = (std::max(1u, depth >> level) + blockDepth - 1) / blockDepth;
+        bytes += blocksWide * blocksHigh * blocksDeep * data.valueSize();
+    }
+    return bytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+//
+// VsgMemoryAnalysis
+//
+VsgMemoryAnalysis::VsgMemoryAnalysis() :
+    _memoryStats(new MemoryStats) {}
+
+VsgMemoryAnalysis::VsgMemoryAnalysis(MemoryStats* memoryStats) :
+    _memoryStats(memoryStats) {}
+
+static bool isDraw(const vsg::Object* object)
+{
+    return dynamic_cast<const vsg::Draw*>(object) || dynamic_cast<const vsg::DrawIndexed*>(object);
+}
+
+void VsgMemoryAnalysis::apply(const vsg::Object& object)
+{
+    // the draw commands of vsg::Commands subgraphs
+    if (isDraw(&object)) ++_memoryStats->pipelineStats[_currentPipeline].draws;
+
+    object.traverse(*this);
+}
+
+void VsgMemoryAnalysis::apply(const vsg::Geometry& geometry)
+{
+    for(auto& array : geometry._arrays)
+    {
+        _memoryStats->insert(MemoryStats::VERTEX_DATA, array.get(), array->dataSize(), _currentPipeline);
+    }
+
+    if (geometry._indices)
+    {
+        _memoryStats->insert(MemoryStats::INDEX_DATA, geometry._indices.get(), geometry._indices->dataSize(), _currentPipeline);
+    }
+
+    for(auto& command : geometry._commands)
+    {
+        if (isDraw(command.get())) ++_memoryStats->pipelineStats[_currentPipeline].draws;
+    }
+}
+
+void VsgMemoryAnalysis::apply(const vsg::VertexIndexDraw& vid)
+{
+    for(auto& array : vid._arrays)
+    {
+        _memoryStats->insert(MemoryStats::VERTEX_DATA, array.get(), array->dataSize(), _currentPipeline);
+    }
+
+    if (vid._indices)
+    {
+        _memoryStats->insert(MemoryStats::INDEX_DATA, vid._indices.get(), vid._indices->dataSize(), _currentPipeline);
+    }
+
+    ++_memoryStats->pipelineStats[_currentPipeline].draws;
+}
+
+void VsgMemoryAnalysis::apply(const vsg::BindVertexBuffers& bvb)
+{
+    for(auto& array : bvb.getArrays())
+    {
+        _memoryStats->insert(MemoryStats::VERTEX_DATA, array.get(), array->dataSize(), _currentPipeline);
+    }
+}
+
+void VsgMemoryAnalysis::apply(const vsg::BindIndexBuffer& bib)
+{
+    if (auto indices = bib.getIndices())
+    {
+        _memoryStats->insert(MemoryStats::INDEX_DATA, indices, indices->dataSize(), _currentPipeline);
+    }
+}
+
+void VsgMemoryAnalysis::apply(const vsg::StateGroup& stategroup)
+{
+    // the state and subgraph below a pipeline bind are attributed to that pipeline
+    auto previousPipeline = _currentPipeline;
+    for(auto& command : stategroup.getStateCommands())
+    {
+        if (auto bindGraphicsPipeline = dynamic_cast<const vsg::BindGraphicsPipeline*>(command.get())) _currentPipeline = bindGraphicsPipeline;
+    }
+
+    for(auto& command : stategroup.getStateCommands())
+    {
+        command->accept(*this);
+    }
+
+    stategroup.traverse(*this);
+
+    _currentPipeline = previousPipeline;
+}
+
+void VsgMemoryAnalysis::apply(const vsg::DescriptorSet& descriptorSet)
+{
+    // a descriptor set's data is allocated once however many times the set is bound, so only count its references on the first visit
+    auto [itr, inserted] = _descriptorSetData.try_emplace(&descriptorSet);
+    if (inserted)
+    {
+        _memoryStats->descriptorSets.insert(&descriptorSet);
+        insertDescriptors(descriptorSet, itr->second);
+    }
+
+    if (_memoryStats->pipelineStats.find(_currentPipeline) == _memoryStats->pipelineStats.end()) _memoryStats->pipelines.push_back(_currentPipeline);
+
+    auto& stats = _memoryStats->pipelineStats[_currentPipeline];
+    stats.descriptorSets.insert(&descriptorSet);
+    for(auto& [category, data] : itr->second)
+    {
+        if (stats.data.insert(data).second) stats.bytes[category] += _memoryStats->dataEntries[category][data].bytes;
+    }
+}
+
+void VsgMemoryAnalysis::insertDescriptors(const vsg::DescriptorSet& descriptorSet, DescriptorData& descriptorData)
+{
+    for(auto& descriptor : descriptorSet._descriptors)
+    {
+        ++_memoryStats->numDescriptors;
+
+        if (auto descriptorImage = descriptor.cast<vsg::DescriptorImage>())
+        {
+            for(auto& samplerImage : descriptorImage->getSamplerImageList())
+            {
+                if (!samplerImage.data) continue;
+
+                auto& entry = _memoryStats->dataEntries[MemoryStats::TEXTURE_DATA][samplerImage.data.get()];
+                entry.bytes = computeImageBytes(*samplerImage.data, samplerImage.sampler.get());
+                ++entry.references;
+                descriptorData.emplace_back(MemoryStats::TEXTURE_DATA, samplerImage.data.get());
+            }
+        }
+        else if (auto descriptorBuffer = descriptor.cast<vsg::DescriptorBuffer>())
+        {
+            for(auto& data : descriptorBuffer->getDataList())
+            {
+                if (!data) continue;
+
+                auto& entry = _memoryStats->dataEntries[MemoryStats::UNIFORM_DATA][data.get()];
+                entry.bytes = data->dataSize();
+                ++entry.references;
+                descriptorData.emplace_back(MemoryStats::UNIFORM_DATA, data.get());
+            }
+        }
+    }
+}
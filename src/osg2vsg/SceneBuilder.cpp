@@ -3,6 +3,7 @@
 #include <osg2vsg/ImageUtils.h>
 #include <osg2vsg/GeometryUtils.h>
 #include <osg2vsg/ShaderUtils.h>
+#include <osg2vsg/ThreadingUtils.h>
 
 #include <vsg/nodes/MatrixTransform.h>
 #include <vsg/nodes/CullGroup.h>
@@ -10,6 +11,11 @@
 
 #include <osg/io_utils>
 
+#include <algorithm>
+#include <limits>
+#include <tuple>
+#include <typeinfo>
+
 using namespace osg2vsg;
 
 #if 0
@@ -23,36 +29,223 @@ vsg::ref_ptr<vsg::BindGraphicsPipeline> PipelineCache::getOrCreateBindGraphicsPi
 {
     Key key(shaderModeMask, geometryAttributesMask, vertShaderPath, fragShaderPath);
 
-    // check to see if pipeline has already been created
+    std::promise<vsg::ref_ptr<vsg::BindGraphicsPipeline>> promise;
+
+    // check to see if pipeline has already been created or is being created by another thread
     {
-        std::lock_guard<std::mutex> guard(mutex);
+        std::unique_lock<std::mutex> lock(mutex);
         if (auto itr = pipelineMap.find(key); itr != pipelineMap.end()) return itr->second;
+
+        if (auto itr = pendingMap.find(key); itr != pendingMap.end())
+        {
+            auto future = itr->second;
+            lock.unlock();
+            return future.get();
+        }
+
+        pendingMap[key] = promise.get_future().share();
+    }
+
+    vsg::ref_ptr<vsg::BindGraphicsPipeline> bindGraphicsPipeline;
+    try
+    {
+        bindGraphicsPipeline = createBindGraphicsPipeline(shaderModeMask, geometryAttributesMask, vertShaderPath, fragShaderPath);
+    }
+    catch(...)
+    {
+        // make sure waiting threads don't block forever
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            pendingMap.erase(key);
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    // assign the pipeline to cache and release any threads waiting on it
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (bindGraphicsPipeline) pipelineMap[key] = bindGraphicsPipeline;
+        pendingMap.erase(key);
+    }
+
+    promise.set_value(bindGraphicsPipeline);
+
+    return bindGraphicsPipeline;
+}
+
+vsg::ref_ptr<vsg::DescriptorSetLayout> PipelineCache::getOrCreateDescriptorSetLayout(const vsg::DescriptorSetLayoutBindings& descriptorBindings)
+{
+    DescriptorSetLayoutKey key;
+    for(auto& binding : descriptorBindings)
+    {
+        key.emplace_back(binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags, binding.pImmutableSamplers);
+    }
+
+    std::lock_guard<std::mutex> guard(layoutMutex);
+
+    auto& descriptorSetLayout = descriptorSetLayouts[key];
+    if (!descriptorSetLayout) descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+    return descriptorSetLayout;
+}
+
+vsg::ref_ptr<vsg::PipelineLayout> PipelineCache::getOrCreatePipelineLayout(const vsg::DescriptorSetLayouts& in_descriptorSetLayouts, const vsg::PushConstantRanges& pushConstantRanges)
+{
+    PipelineLayoutKey key;
+    for(auto& descriptorSetLayout : in_descriptorSetLayouts) key.first.push_back(descriptorSetLayout.get());
+    for(auto& range : pushConstantRanges) key.second.emplace_back(range.stageFlags, range.offset, range.size);
+
+    std::lock_guard<std::mutex> guard(layoutMutex);
+
+    auto& pipelineLayout = pipelineLayouts[key];
+    if (!pipelineLayout) pipelineLayout = vsg::PipelineLayout::create(in_descriptorSetLayouts, pushConstantRanges);
+    return pipelineLayout;
+}
+
+bool PipelineCache::supportsMaterialStorageBuffer() const
+{
+    return 128 + sizeof(uint32_t) <= deviceLimits.maxPushConstantsSize;
+}
+
+bool PipelineCache::supportsBindlessTextures() const
+{
+    // element 0 is the white texture, so at least one more is needed for the array to be of use
+    return (128 + 6 * sizeof(uint32_t) <= deviceLimits.maxPushConstantsSize) &&
+           deviceLimits.sampledImageArrayDynamicIndexing &&
+           maxBindlessTextures >= 2 &&
+           maxBindlessTextures <= deviceLimits.maxPerStageDescriptorSamplers &&
+           maxBindlessTextures <= deviceLimits.maxPerStageDescriptorSampledImages &&
+           maxBindlessTextures <= deviceLimits.maxDescriptorSetSamplers &&
+           maxBindlessTextures <= deviceLimits.maxDescriptorSetSampledImages;
+}
+
+bool PipelineCache::compileShaders(vsg::ShaderStages& shaders)
+{
+    // the SPIR-V compiled at build time isn't optimized, validated or measured, so compile with glslang when any of those are requested
+    auto& optimizeOptions = shaderCompiler->optimizeOptions;
+    if (optimizeOptions.changesSPIRV() || optimizeOptions.validate || optimizeOptions.reportSizes) return shaderCompiler->compile(shaders);
+
+    // use the SPIR-V compiled at build time when all the stages are available, otherwise fall back to compiling with glslang
+    std::vector<vsg::ShaderModule::SPIRV> precompiledSPIRV(shaders.size());
+    size_t numPrecompiled = 0;
+    for(size_t i=0; i<shaders.size(); ++i)
+    {
+        if (getPrecompiledSPIRV(shaders[i]->getShaderStageFlagBits(), shaders[i]->getShaderModule()->source(), precompiledSPIRV[i])) ++numPrecompiled;
+    }
+
+    if (numPrecompiled != shaders.size()) return shaderCompiler->compile(shaders);
+
+    for(size_t i=0; i<shaders.size(); ++i) shaders[i]->getShaderModule()->spirv().swap(precompiledSPIRV[i]);
+    return true;
+}
+
+vsg::ShaderStages PipelineCache::createUberShaderStages(uint32_t shaderModeMask, uint32_t geometryAttributesMask)
+{
+    // only the geometry attributes inject defines into the uber shaders so the shader modules are shared between all the pipelines with the same attributes
+    uint32_t uberShaderKey = geometryAttributesMask & (NORMAL | TANGENT | COLOR | TEXCOORD0 | TRANSLATE);
+
+    vsg::ref_ptr<vsg::ShaderModule> vertexModule;
+    vsg::ref_ptr<vsg::ShaderModule> fragmentModule;
+    {
+        // compiles are held under the lock as there are only a handful of uber shader variants
+        std::lock_guard<std::mutex> guard(uberShaderMutex);
+
+        auto& modules = uberShaderModules[uberShaderKey];
+        if (!modules.first || !modules.second)
+        {
+            vsg::ShaderStages shaders;
+            {
+                ScopedTiming timing(instrumentation.get(), "shader preprocessing");
+                shaders = {
+                    vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, "main", createFbxUberVertexSource(geometryAttributesMask)),
+                    vsg::ShaderStage::create(VK_SHADER_STAGE_FRAGMENT_BIT, "main", createFbxUberFragmentSource(geometryAttributesMask))
+                };
+            }
+
+            if (!compileShaders(shaders)) return vsg::ShaderStages();
+
+            modules.first = shaders[0]->getShaderModule();
+            modules.second = shaders[1]->getShaderModule();
+        }
+
+        vertexModule = modules.first;
+        fragmentModule = modules.second;
     }
 
+    // specialize the shared modules for this pipeline's shaderModeMask
+    auto specializationMapEntries = createUberShaderSpecializationMapEntries();
+    auto specializationData = createUberShaderSpecializationData(shaderModeMask, geometryAttributesMask);
 
     vsg::ShaderStages shaders{
-        vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, "main", vertShaderPath.empty() ? createFbxVertexSource(shaderModeMask, geometryAttributesMask) : readGLSLShader(vertShaderPath, shaderModeMask, geometryAttributesMask)),
-        vsg::ShaderStage::create(VK_SHADER_STAGE_FRAGMENT_BIT, "main", fragShaderPath.empty() ? createFbxFragmentSource(shaderModeMask, geometryAttributesMask) : readGLSLShader(fragShaderPath, shaderModeMask, geometryAttributesMask))
+        vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, "main", vertexModule),
+        vsg::ShaderStage::create(VK_SHADER_STAGE_FRAGMENT_BIT, "main", fragmentModule)
     };
 
-    if (!shaderCompiler->compile(shaders)) return vsg::ref_ptr<vsg::BindGraphicsPipeline>();
+    for(auto& shader : shaders)
+    {
+        shader->setSpecializationMapEntries(specializationMapEntries);
+        shader->setSpecializationData(specializationData);
+    }
+
+    return shaders;
+}
+
+vsg::ref_ptr<vsg::BindGraphicsPipeline> PipelineCache::createBindGraphicsPipeline(uint32_t shaderModeMask, uint32_t geometryAttributesMask, const std::string& vertShaderPath, const std::string& fragShaderPath)
+{
+    bool uberShaders = usesUberShaders(vertShaderPath, fragShaderPath);
+
+    vsg::ShaderStages shaders;
+    if (uberShaders)
+    {
+        shaders = createUberShaderStages(shaderModeMask, geometryAttributesMask);
+        if (shaders.empty()) return vsg::ref_ptr<vsg::BindGraphicsPipeline>();
+    }
+    else
+    {
+        {
+            ScopedTiming timing(instrumentation.get(), "shader preprocessing");
+            shaders = {
+                vsg::ShaderStage::create(VK_SHADER_STAGE_VERTEX_BIT, "main", vertShaderPath.empty() ? createFbxVertexSource(shaderModeMask, geometryAttributesMask) : readGLSLShader(vertShaderPath, shaderModeMask, geometryAttributesMask)),
+                vsg::ShaderStage::create(VK_SHADER_STAGE_FRAGMENT_BIT, "main", fragShaderPath.empty() ? createFbxFragmentSource(shaderModeMask, geometryAttributesMask) : readGLSLShader(fragShaderPath, shaderModeMask, geometryAttributesMask))
+            };
+        }
+
+        if (!compileShaders(shaders)) return vsg::ref_ptr<vsg::BindGraphicsPipeline>();
+
+        // size the fragment shader's bindless texture array to match the layout's descriptorCount
+        if (shaderModeMask & BINDLESS_TEXTURES)
+        {
+            shaders[1]->setSpecializationMapEntries({VkSpecializationMapEntry{0, 0, sizeof(uint32_t)}});
+            shaders[1]->setSpecializationData(vsg::uintValue::create(maxBindlessTextures));
+        }
+    }
 
     // std::cout<<"createBindGraphicsPipeline("<<shaderModeMask<<", "<<geometryAttributesMask<<")"<<std::endl;
 
+    // the uber shaders always declare the material and all the textures so they share a single layout
+    uint32_t layoutShaderModeMask = uberShaders ? (MATERIAL | DIFFUSE_MAP | OPACITY_MAP | AMBIENT_MAP | NORMAL_MAP | SPECULAR_MAP) : shaderModeMask;
+
     vsg::DescriptorSetLayoutBindings descriptorBindings;
 
     // add material first if any (for now material is hardcoded to binding MATERIAL_BINDING)
-    if (shaderModeMask & MATERIAL) descriptorBindings.push_back({ MATERIAL_BINDING, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }); // { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
+    VkDescriptorType materialDescriptorType = (shaderModeMask & MATERIAL_STORAGE_BUFFER) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    if (layoutShaderModeMask & MATERIAL) descriptorBindings.push_back({ MATERIAL_BINDING, materialDescriptorType, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }); // { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
 
     // these need to go in incremental order by texture unit value as that how they will have been added to the desctiptor set
     // VkDescriptorSetLayoutBinding { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
-    if (shaderModeMask & DIFFUSE_MAP) descriptorBindings.push_back({ DIFFUSE_TEXTURE_UNIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }); // { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
-    if (shaderModeMask & OPACITY_MAP) descriptorBindings.push_back({ OPACITY_TEXTURE_UNIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr });
-    if (shaderModeMask & AMBIENT_MAP) descriptorBindings.push_back({ AMBIENT_TEXTURE_UNIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr });
-    if (shaderModeMask & NORMAL_MAP) descriptorBindings.push_back({ NORMAL_TEXTURE_UNIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr });
-    if (shaderModeMask & SPECULAR_MAP) descriptorBindings.push_back({ SPECULAR_TEXTURE_UNIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr });
+    if (layoutShaderModeMask & BINDLESS_TEXTURES)
+    {
+        // all the texture maps are selected from a single array
+        descriptorBindings.push_back({ BINDLESS_TEXTURE_BINDING, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxBindlessTextures, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr });
+        layoutShaderModeMask &= ~(DIFFUSE_MAP | OPACITY_MAP | AMBIENT_MAP | NORMAL_MAP | SPECULAR_MAP);
+    }
+    if (layoutShaderModeMask & DIFFUSE_MAP) descriptorBindings.push_back({ DIFFUSE_TEXTURE_UNIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr }); // { binding, descriptorTpe, descriptorCount, stageFlags, pImmutableSamplers}
+    if (layoutShaderModeMask & OPACITY_MAP) descriptorBindings.push_back({ OPACITY_TEXTURE_UNIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr });
+    if (layoutShaderModeMask & AMBIENT_MAP) descriptorBindings.push_back({ AMBIENT_TEXTURE_UNIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr });
+    if (layoutShaderModeMask & NORMAL_MAP) descriptorBindings.push_back({ NORMAL_TEXTURE_UNIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr });
+    if (layoutShaderModeMask & SPECULAR_MAP) descriptorBindings.push_back({ SPECULAR_TEXTURE_UNIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr });
 
-    auto descriptorSetLayout = vsg::DescriptorSetLayout::create(descriptorBindings);
+    auto descriptorSetLayout = getOrCreateDescriptorSetLayout(descriptorBindings);
     vsg::DescriptorSetLayouts descriptorSetLayouts{descriptorSetLayout};
 
     vsg::PushConstantRanges pushConstantRanges
@@ -60,6 +253,10 @@ vsg::ref_ptr<vsg::BindGraphicsPipeline> PipelineCache::getOrCreateBindGraphicsPi
         {VK_SHADER_STAGE_VERTEX_BIT, 0, 128} // projection and modelview matrices
     };
 
+    // the fragment shader's material index, followed by the diffuse, opacity, ambient, normal and specular texture indices when using bindless textures
+    if (shaderModeMask & BINDLESS_TEXTURES) pushConstantRanges.push_back({VK_SHADER_STAGE_FRAGMENT_BIT, 128, 6 * sizeof(uint32_t)});
+    else if (shaderModeMask & MATERIAL_STORAGE_BUFFER) pushConstantRanges.push_back({VK_SHADER_STAGE_FRAGMENT_BIT, 128, sizeof(uint32_t)});
+
     uint32_t vertexBindingIndex = 0;
 
     vsg::VertexInputState::Bindings vertexBindingsDescriptions;
@@ -107,7 +304,7 @@ vsg::ref_ptr<vsg::BindGraphicsPipeline> PipelineCache::getOrCreateBindGraphicsPi
         vertexBindingIndex++;
     }
 
-    auto pipelineLayout = vsg::PipelineLayout::create(descriptorSetLayouts, pushConstantRanges);
+    auto pipelineLayout = getOrCreatePipelineLayout(descriptorSetLayouts, pushConstantRanges);
 
     // if blending is requested setup appropriate colorblendstate
     vsg::ColorBlendState::ColorBlendAttachments colorBlendAttachments;
@@ -145,22 +342,18 @@ vsg::ref_ptr<vsg::BindGraphicsPipeline> PipelineCache::getOrCreateBindGraphicsPi
     // set up graphics pipeline
     //
     vsg::ref_ptr<vsg::GraphicsPipeline> graphicsPipeline = vsg::GraphicsPipeline::create(pipelineLayout, shaders, pipelineStates);
-    auto bindGraphicsPipeline = vsg::BindGraphicsPipeline::create(graphicsPipeline);
-
-    // assigne the pipeline to cache.
-    std::lock_guard<std::mutex> guard(mutex);
-    pipelineMap[key] = bindGraphicsPipeline;
-
-    return bindGraphicsPipeline;
+    return vsg::BindGraphicsPipeline::create(graphicsPipeline);
 }
 
 
 osg::ref_ptr<osg::StateSet> SceneBuilderBase::uniqueState(osg::ref_ptr<osg::StateSet> stateset, bool programStateSet)
 {
-    if (auto itr = uniqueStateSets.find(stateset); itr != uniqueStateSets.end())
+    if (!stateset) return stateset;
+
+    if (auto unique = uniqueStateSets.insert(stateset); unique != stateset)
     {
         DEBUG_OUTPUT<<"    uniqueState() found state"<<std::endl;
-        return *itr;
+        return unique;
     }
 
     DEBUG_OUTPUT<<"    uniqueState() inserting state"<<std::endl;
@@ -168,11 +361,10 @@ osg::ref_ptr<osg::StateSet> SceneBuilderBase::uniqueState(osg::ref_ptr<osg::Stat
 
     if (writeToFileProgramAndDataSetSets && stateset.valid())
     {
-        if (programStateSet) osgDB::writeObjectFile(*(stateset), vsg::make_string("programState_", stateMap.size(),".osgt"));
-        else osgDB::writeObjectFile(*(stateset), vsg::make_string("dataState_", stateMap.size(),".osgt"));
+        if (programStateSet) osgDB::writeObjectFile(*(stateset), vsg::make_string("programState_", uniqueStateSets.size(),".osgt"));
+        else osgDB::writeObjectFile(*(stateset), vsg::make_string("dataState_", uniqueStateSets.size(),".osgt"));
     }
 
-    uniqueStateSets.insert(stateset);
     return stateset;
 }
 
@@ -180,6 +372,8 @@ SceneBuilderBase::StatePair SceneBuilderBase::computeStatePair(osg::StateSet* st
 {
     if (!stateset) return StatePair();
 
+    ScopedTiming timing(buildOptions->instrumentation.get(), "state uniquing");
+
     osg::ref_ptr<osg::StateSet> programState = new osg::StateSet;
     osg::ref_ptr<osg::StateSet> dataState = new osg::StateSet;
 
@@ -207,34 +401,63 @@ SceneBuilderBase::StatePair SceneBuilderBase::computeStatePair(osg::StateSet* st
 
 SceneBuilderBase::StatePair& SceneBuilderBase::getStatePair()
 {
-    auto& statepair = stateMap[statestack];
+    auto& statepair = currentStateNode->statePair;
+
+    if (currentStateNode->depth > 0 && (!statepair.first || !statepair.second))
+    {
+        statepair = computeStatePair(getCombinedStateSet(*currentStateNode));
+    }
+    return statepair;
+}
 
-    if (!statestack.empty() && (!statepair.first || !statepair.second))
+osg::StateSet* SceneBuilderBase::getCombinedStateSet(StateNode& node)
+{
+    if (!node.combined)
     {
-        osg::ref_ptr<osg::StateSet> combined;
-        if (statestack.size()==1)
+        if (node.depth==1)
         {
-            combined = statestack.back();
+            node.combined = node.stateset;
         }
         else
         {
-            combined = new osg::StateSet;
-            for(auto& stateset : statestack)
-            {
-                combined->merge(*stateset);
-            }
+            // merge onto a copy of the parent's merged state so each level of the stack is only merged once
+            node.combined = new osg::StateSet(*getCombinedStateSet(*node.parent), osg::CopyOp::SHALLOW_COPY);
+            node.combined->merge(*node.stateset);
         }
+    }
+    return node.combined.get();
+}
 
-        statepair = computeStatePair(combined);
-
+void SceneBuilderBase::pushStateSet(osg::StateSet& stateset)
+{
+    auto& child = currentStateNode->children[&stateset];
+    if (!child)
+    {
+        child.reset(new StateNode);
+        child->parent = currentStateNode;
+        child->stateset = &stateset;
+        child->depth = currentStateNode->depth + 1;
     }
-    return statepair;
+    currentStateNode = child.get();
 }
 
-vsg::ref_ptr<vsg::DescriptorImage> SceneBuilderBase::convertToVsgTexture(const osg::Texture* osgtexture)
+void SceneBuilderBase::popStateSet()
 {
-    if (auto itr = texturesMap.find(osgtexture); itr != texturesMap.end()) return itr->second;
+    if (currentStateNode->parent) currentStateNode = currentStateNode->parent;
+}
 
+// texture units that are mapped to descriptors, paired with the ShaderModeMask that enables them, in the order they are added to the descriptor set
+static const std::pair<uint32_t, uint32_t> s_textureUnitModes[] =
+{
+    {DIFFUSE_TEXTURE_UNIT, DIFFUSE_MAP},
+    {OPACITY_TEXTURE_UNIT, OPACITY_MAP},
+    {AMBIENT_TEXTURE_UNIT, AMBIENT_MAP},
+    {NORMAL_TEXTURE_UNIT, NORMAL_MAP},
+    {SPECULAR_TEXTURE_UNIT, SPECULAR_MAP}
+};
+
+static vsg::ref_ptr<vsg::DescriptorImage> createDescriptorImage(const osg::Texture* osgtexture)
+{
     const osg::Image* image = osgtexture ? osgtexture->getImage(0) : nullptr;
     auto textureData = convertToVsg(image);
     if (!textureData)
@@ -246,15 +469,138 @@ vsg::ref_ptr<vsg::DescriptorImage> SceneBuilderBase::convertToVsgTexture(const o
     vsg::ref_ptr<vsg::Sampler> sampler = vsg::Sampler::create();
     sampler->info() = convertToSamplerCreateInfo(osgtexture);
 
-    auto texture = vsg::DescriptorImage::create(vsg::SamplerImage { sampler, textureData }, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-    texturesMap[osgtexture] = texture;
+    return vsg::DescriptorImage::create(vsg::SamplerImage { sampler, textureData }, 0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+}
+
+vsg::ref_ptr<vsg::DescriptorImage> SceneBuilderBase::convertToVsgTexture(const osg::Texture* osgtexture)
+{
+    if (auto itr = texturesMap.find(osgtexture); itr != texturesMap.end()) return itr->second;
+
+    auto texture = createDescriptorImage(osgtexture);
+    if (texture) texturesMap[osgtexture] = texture;
 
     return texture;
 }
 
+void SceneBuilderBase::collectTextures(const osg::StateSet* stateset, uint32_t shaderModeMask, Textures& textures) const
+{
+    if (!stateset) return;
+
+    for(auto& [unit, mode] : s_textureUnitModes)
+    {
+        if ((shaderModeMask & mode)==0) continue;
+
+        const osg::Texture* osgtex = dynamic_cast<const osg::Texture*>(stateset->getTextureAttribute(unit, osg::StateAttribute::TEXTURE));
+        if (osgtex && osgtex->getImage(0)) textures.insert(osgtex);
+    }
+}
+
+void SceneBuilderBase::collectTextures(osg::Node* node, Textures& textures) const
+{
+    if (!node) return;
+
+    struct CollectTextures : public osg::NodeVisitor
+    {
+        const SceneBuilderBase& builder;
+        uint32_t shaderModeMask;
+        Textures& textures;
+
+        CollectTextures(const SceneBuilderBase& in_builder, uint32_t in_shaderModeMask, Textures& in_textures) :
+            osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN),
+            builder(in_builder),
+            shaderModeMask(in_shaderModeMask),
+            textures(in_textures) {}
+
+        void apply(osg::Node& node) override
+        {
+            builder.collectTextures(node.getStateSet(), shaderModeMask, textures);
+            traverse(node);
+        }
+
+        void apply(osg::Drawable& drawable) override
+        {
+            builder.collectTextures(drawable.getStateSet(), shaderModeMask, textures);
+        }
+    };
+
+    // textures in units that the shaders can't use will never be converted
+    uint32_t shaderModeMask = (ShaderModeMask::ALL_SHADER_MODE_MASK | buildOptions->overrideShaderModeMask) & buildOptions->supportedShaderModeMask;
+
+    CollectTextures collector(*this, shaderModeMask, textures);
+    node->accept(collector);
+}
+
+void SceneBuilderBase::convertTextures(const Textures& textures)
+{
+    std::vector<const osg::Texture*> texturesToConvert;
+    for(auto& osgtexture : textures)
+    {
+        if (texturesMap.count(osgtexture)==0) texturesToConvert.push_back(osgtexture);
+    }
+
+    DEBUG_OUTPUT<<"convertTextures() converting "<<texturesToConvert.size()<<" textures with "<<buildOptions->numThreads<<" threads"<<std::endl;
+
+    // each texture is converted independently into its own slot so no locking is required
+    std::vector<vsg::ref_ptr<vsg::DescriptorImage>> convertedTextures(texturesToConvert.size());
+    parallelFor(buildOptions->numThreads, texturesToConvert.size(), [&](size_t i)
+    {
+        ScopedTiming timing(buildOptions->instrumentation.get(), "image conversion");
+        convertedTextures[i] = createDescriptorImage(texturesToConvert[i]);
+    });
+
+    count(buildOptions->instrumentation.get(), "textures converted", static_cast<int64_t>(texturesToConvert.size()));
+
+    for(size_t i=0; i<texturesToConvert.size(); ++i)
+    {
+        if (convertedTextures[i]) texturesMap[texturesToConvert[i]] = convertedTextures[i];
+    }
+}
+
+// 1x1 white texture used in place of the textures that a stateset doesn't provide, written to count consecutive array elements
+static vsg::ref_ptr<vsg::DescriptorImage> createWhiteTexture(vsg::ref_ptr<vsg::Sampler> sampler, uint32_t binding, uint32_t arrayElement, uint32_t count = 1)
+{
+    static vsg::ref_ptr<vsg::Data> s_whiteImage = []()
+    {
+        vsg::ref_ptr<vsg::Data> image(new vsg::ubvec4Array2D(1, 1, new vsg::ubvec4[1]{vsg::ubvec4(255, 255, 255, 255)}));
+        image->setFormat(VK_FORMAT_R8G8B8A8_UNORM);
+        return image;
+    }();
+
+    return vsg::DescriptorImage::create(vsg::SamplerImages(count, vsg::SamplerImage{sampler, s_whiteImage}), binding, arrayElement, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+}
+
+vsg::ref_ptr<vsg::Sampler> SceneBuilderBase::getOrCreateWhiteTextureSampler()
+{
+    if (!whiteTextureSampler) whiteTextureSampler = vsg::Sampler::create();
+    return whiteTextureSampler;
+}
+
+vsg::ref_ptr<vsg::Descriptor> SceneBuilderBase::getOrCreateDefaultDescriptor(uint32_t binding)
+{
+    if (auto itr = defaultDescriptors.find(binding); itr != defaultDescriptors.end()) return itr->second;
+
+    vsg::ref_ptr<vsg::Descriptor> descriptor;
+    if (binding == MATERIAL_BINDING)
+    {
+        osg::ref_ptr<osg::Material> material = new osg::Material;
+        descriptor = vsg::DescriptorBuffer::create(convertToMaterialValue(material.get()), MATERIAL_BINDING);
+    }
+    else
+    {
+        // the uber shaders don't sample it unless the matching ShaderModeMask bit is set
+        descriptor = createWhiteTexture(getOrCreateWhiteTextureSampler(), binding, 0);
+    }
+
+    defaultDescriptors[binding] = descriptor;
+    return descriptor;
+}
+
 vsg::ref_ptr<vsg::DescriptorSet> SceneBuilderBase::createVsgStateSet(const vsg::DescriptorSetLayouts& descriptorSetLayouts, const osg::StateSet* stateset, uint32_t shaderModeMask)
 {
-    if (!stateset) return vsg::ref_ptr<vsg::DescriptorSet>();
+    // the uber shaders' descriptor set layout requires every binding to be assigned, substituting defaults for the missing ones
+    bool uberShaders = buildOptions->pipelineCache->usesUberShaders(buildOptions->vertexShaderPath, buildOptions->fragmentShaderPath);
+
+    if (!stateset && !uberShaders) return vsg::ref_ptr<vsg::DescriptorSet>();
 
     uint32_t texcount = 0;
 
@@ -262,7 +608,7 @@ vsg::ref_ptr<vsg::DescriptorSet> SceneBuilderBase::createVsgStateSet(const vsg::
 
     auto addTexture = [&] (unsigned int i)
     {
-        const osg::StateAttribute* texatt = stateset->getTextureAttribute(i, osg::StateAttribute::TEXTURE);
+        const osg::StateAttribute* texatt = stateset ? stateset->getTextureAttribute(i, osg::StateAttribute::TEXTURE) : nullptr;
         const osg::Texture* osgtex = dynamic_cast<const osg::Texture*>(texatt);
         if (osgtex)
         {
@@ -273,29 +619,50 @@ vsg::ref_ptr<vsg::DescriptorSet> SceneBuilderBase::createVsgStateSet(const vsg::
                 vsgtex->_dstBinding = i;
                 texcount++; //
                 descriptors.push_back(vsgtex);
+                return;
             }
             else
             {
                 std::cout<<"createVsgStateSet(..) osg::Texture, with i="<<i<<" found but cannot be mapped to vsg::DescriptorImage."<<std::endl;
             }
         }
+
+        if (uberShaders) descriptors.push_back(getOrCreateDefaultDescriptor(i));
     };
 
     // add material first
-    const osg::Material* osg_material = dynamic_cast<const osg::Material*>(stateset->getAttribute(osg::StateAttribute::Type::MATERIAL));
-    if ((shaderModeMask & ShaderModeMask::MATERIAL) && (osg_material != nullptr) /*&& stateset->getMode(GL_COLOR_MATERIAL) == osg::StateAttribute::Values::ON*/)
+    const osg::Material* osg_material = stateset ? dynamic_cast<const osg::Material*>(stateset->getAttribute(osg::StateAttribute::Type::MATERIAL)) : nullptr;
+    if ((shaderModeMask & ShaderModeMask::MATERIAL) && (shaderModeMask & ShaderModeMask::MATERIAL_STORAGE_BUFFER))
+    {
+        // the material is selected from the storage buffer with a push constant so all the statesets share the descriptor
+        descriptors.push_back(materialBufferDescriptor);
+    }
+    else if ((shaderModeMask & ShaderModeMask::MATERIAL) && (osg_material != nullptr) /*&& stateset->getMode(GL_COLOR_MATERIAL) == osg::StateAttribute::Values::ON*/)
     {
         vsg::ref_ptr<vsg::MaterialValue> matdata = convertToMaterialValue(osg_material);
         auto vsg_materialUniform = vsg::DescriptorBuffer::create(matdata, MATERIAL_BINDING); // just use high value for now, should maybe put uniforms into a different descriptor set to simplify binding indexes
         descriptors.push_back(vsg_materialUniform);
     }
+    else if (uberShaders)
+    {
+        descriptors.push_back(getOrCreateDefaultDescriptor(MATERIAL_BINDING));
+    }
 
     // add textures
-    if (shaderModeMask & ShaderModeMask::DIFFUSE_MAP) addTexture(DIFFUSE_TEXTURE_UNIT);
-    if (shaderModeMask & ShaderModeMask::OPACITY_MAP) addTexture(OPACITY_TEXTURE_UNIT);
-    if (shaderModeMask & ShaderModeMask::AMBIENT_MAP) addTexture(AMBIENT_TEXTURE_UNIT);
-    if (shaderModeMask & ShaderModeMask::NORMAL_MAP) addTexture(NORMAL_TEXTURE_UNIT);
-    if (shaderModeMask & ShaderModeMask::SPECULAR_MAP) addTexture(SPECULAR_TEXTURE_UNIT);
+    if (shaderModeMask & BINDLESS_TEXTURES)
+    {
+        // the texture maps are selected from the array with push constants so all the statesets share the descriptors
+        if (bindlessTextureDescriptors.empty()) assignTextureIndices(Textures());
+        descriptors.insert(descriptors.end(), bindlessTextureDescriptors.begin(), bindlessTextureDescriptors.end());
+    }
+    else
+    {
+        for(auto& [unit, mode] : s_textureUnitModes)
+        {
+            if (shaderModeMask & mode) addTexture(unit);
+            else if (uberShaders) descriptors.push_back(getOrCreateDefaultDescriptor(unit));
+        }
+    }
 
     if (descriptors.size() == 0) return vsg::ref_ptr<vsg::DescriptorSet>();
 
@@ -304,6 +671,142 @@ vsg::ref_ptr<vsg::DescriptorSet> SceneBuilderBase::createVsgStateSet(const vsg::
     return descriptorSet;
 }
 
+uint32_t SceneBuilderBase::getOrAssignMaterialIndex(const osg::StateSet* stateset)
+{
+    osg::ref_ptr<const osg::Material> material = stateset ? dynamic_cast<const osg::Material*>(stateset->getAttribute(osg::StateAttribute::Type::MATERIAL)) : nullptr;
+    if (!material) material = new osg::Material;
+
+    if (auto itr = materialIndices.find(material); itr != materialIndices.end()) return itr->second;
+
+    uint32_t index = static_cast<uint32_t>(materialIndices.size());
+    materialIndices[material] = index;
+    return index;
+}
+
+void SceneBuilderBase::createMaterialBuffer()
+{
+    if (materialIndices.empty()) return;
+
+    // std430 layout of the shaders' MaterialData array, each entry is padded to 4 vec4s
+    auto materials = vsg::vec4Array::create(static_cast<uint32_t>(materialIndices.size() * 4));
+    for(auto& [material, index] : materialIndices)
+    {
+        auto materialValue = convertToMaterialValue(material.get());
+        auto& value = materialValue->value();
+        materials->at(index * 4) = value.ambientColor;
+        materials->at(index * 4 + 1) = value.diffuseColor;
+        materials->at(index * 4 + 2) = value.specularColor;
+        materials->at(index * 4 + 3) = vsg::vec4(value.shine, 0.0f, 0.0f, 0.0f);
+    }
+
+    materialBufferDescriptor = vsg::DescriptorBuffer::create(materials, MATERIAL_BINDING, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+}
+
+vsg::ref_ptr<vsg::PushConstants> SceneBuilderBase::getOrCreateMaterialIndexPushConstants(const osg::StateSet* stateset)
+{
+    uint32_t index = getOrAssignMaterialIndex(stateset);
+    if (index >= materialIndexPushConstants.size()) materialIndexPushConstants.resize(index + 1);
+
+    auto& pushConstants = materialIndexPushConstants[index];
+    if (!pushConstants) pushConstants = vsg::PushConstants::create(VK_SHADER_STAGE_FRAGMENT_BIT, 128, vsg::uintValue::create(index));
+    return pushConstants;
+}
+
+void SceneBuilderBase::assignTextureIndices(const Textures& textures)
+{
+    uint32_t maxBindlessTextures = buildOptions->pipelineCache->maxBindlessTextures;
+
+    // element 0 is reserved for the white texture used for missing maps
+    for(auto& osgtexture : textures)
+    {
+        if (textureIndices.count(osgtexture)) continue;
+
+        if (textureIndices.size() + 1 >= maxBindlessTextures)
+        {
+            std::cout<<"assignTextureIndices(..) more than "<<(maxBindlessTextures - 1)<<" textures, remaining textures will use the default white texture."<<std::endl;
+            break;
+        }
+
+        auto itr = texturesMap.find(osgtexture);
+        if (itr == texturesMap.end()) continue;
+
+        uint32_t index = static_cast<uint32_t>(textureIndices.size() + 1);
+        textureIndices[osgtexture] = index;
+
+        // the converted texture is only used as an element of the array in this mode
+        itr->second->_dstBinding = BINDLESS_TEXTURE_BINDING;
+        itr->second->_dstArrayElement = index;
+    }
+
+    // every element of the array must be written, the indices are assigned consecutively so the unused elements are element 0 and
+    // those after the last texture, each written by one white texture descriptor sharing the one sampler
+    uint32_t numUsed = static_cast<uint32_t>(textureIndices.size()) + 1;
+
+    bindlessTextureDescriptors.clear();
+    bindlessTextureDescriptors.push_back(createWhiteTexture(getOrCreateWhiteTextureSampler(), BINDLESS_TEXTURE_BINDING, 0));
+    for(auto& [osgtexture, index] : textureIndices) bindlessTextureDescriptors.push_back(texturesMap[osgtexture]);
+    if (numUsed < maxBindlessTextures)
+    {
+        bindlessTextureDescriptors.push_back(createWhiteTexture(getOrCreateWhiteTextureSampler(), BINDLESS_TEXTURE_BINDING, numUsed, maxBindlessTextures - numUsed));
+    }
+}
+
+vsg::ref_ptr<vsg::PushConstants> SceneBuilderBase::getOrCreateTextureIndicesPushConstants(const osg::StateSet* stateset, uint32_t shaderModeMask)
+{
+    // in the same order as the texture indices in the shaders' push constants
+    std::vector<uint32_t> indices;
+    for(auto& [unit, mode] : s_textureUnitModes)
+    {
+        const osg::Texture* osgtex = (stateset && (shaderModeMask & mode)) ? dynamic_cast<const osg::Texture*>(stateset->getTextureAttribute(unit, osg::StateAttribute::TEXTURE)) : nullptr;
+        auto itr = textureIndices.find(osgtex);
+        indices.push_back(itr != textureIndices.end() ? itr->second : 0);
+    }
+
+    auto& pushConstants = textureIndicesPushConstants[indices];
+    if (!pushConstants)
+    {
+        auto data = vsg::uintArray::create(static_cast<uint32_t>(indices.size()));
+        for(size_t i = 0; i < indices.size(); ++i) data->at(i) = indices[i];
+
+        // the texture indices follow the material index in the fragment push constants
+        pushConstants = vsg::PushConstants::create(VK_SHADER_STAGE_FRAGMENT_BIT, 128 + sizeof(uint32_t), data);
+    }
+    return pushConstants;
+}
+
+vsg::ref_ptr<vsg::DescriptorSet> SceneBuilderBase::getOrCreateDescriptorSet(const vsg::DescriptorSetLayouts& descriptorSetLayouts, const osg::StateSet* stateset, uint32_t shaderModeMask)
+{
+    if (descriptorSetLayouts.empty()) return vsg::ref_ptr<vsg::DescriptorSet>();
+
+    // only the material and texture map bits affect the descriptors createVsgStateSet(..) assigns
+    uint32_t descriptorMask = shaderModeMask & (MATERIAL | DIFFUSE_MAP | OPACITY_MAP | AMBIENT_MAP | NORMAL_MAP | SPECULAR_MAP);
+
+    // the material storage buffer and the bindless texture array are shared by all the statesets, so only the remaining descriptors distinguish them
+    bool materialInSet = (shaderModeMask & MATERIAL) && !(shaderModeMask & MATERIAL_STORAGE_BUFFER);
+    bool texturesInSet = !(shaderModeMask & BINDLESS_TEXTURES);
+
+    DescriptorSetKey key(descriptorSetLayouts.front().get(), nullptr, descriptorMask, {});
+    if (materialInSet || (texturesInSet && !(shaderModeMask & MATERIAL_STORAGE_BUFFER)))
+    {
+        std::get<1>(key) = stateset;
+    }
+    else if (texturesInSet)
+    {
+        // statesets with the same textures share the descriptor set
+        for(auto& [unit, mode] : s_textureUnitModes)
+        {
+            const osg::Texture* osgtex = (stateset && (shaderModeMask & mode)) ? dynamic_cast<const osg::Texture*>(stateset->getTextureAttribute(unit, osg::StateAttribute::TEXTURE)) : nullptr;
+            std::get<3>(key).push_back(osgtex);
+        }
+    }
+
+    if (auto itr = descriptorSetMap.find(key); itr != descriptorSetMap.end()) return itr->second;
+
+    auto descriptorSet = createVsgStateSet(descriptorSetLayouts, stateset, shaderModeMask);
+    descriptorSetMap[key] = descriptorSet;
+    return descriptorSet;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////////////
 //
@@ -350,23 +853,10 @@ void SceneBuilder::apply(osg::Transform& transform)
     if (transform.getStateSet()) popStateSet();
 }
 
-void SceneBuilder::apply(osg::Billboard& billboard)
+namespace
 {
-    DEBUG_OUTPUT<<"apply(osg::Billboard& billboard)"<<std::endl;
-
-    if (billboard.getStateSet()) pushStateSet(*billboard.getStateSet());
-
-    if (buildOptions->billboardTransform)
-    {
-        nodeShaderModeMasks = BILLBOARD;
-    }
-    else
-    {
-        nodeShaderModeMasks = BILLBOARD | SHADER_TRANSLATE;
-    }
-
-
-    if (nodeShaderModeMasks & SHADER_TRANSLATE)
+    // assign the billboard positions to its geometries as vertex attribute 7 for the SHADER_TRANSLATE shaders
+    void prepareBillboardGeometries(osg::Billboard& billboard)
     {
         using Positions = std::vector<osg::Vec3>;
         using ChildPositions = std::map<osg::Drawable*, Positions>;
@@ -409,7 +899,6 @@ void SceneBuilder::apply(osg::Billboard& billboard)
             }
         };
 
-
         for(auto&[child, positions] : childPositions)
         {
             osg::Geometry* geometry = child->asGeometry();
@@ -420,17 +909,63 @@ void SceneBuilder::apply(osg::Billboard& billboard)
                 osg::ref_ptr<osg::Vec3Array> positionArray = new osg::Vec3Array(positions.begin(), positions.end());
                 positionArray->setBinding(osg::Array::BIND_OVERALL);
                 geometry->setVertexAttribArray(7, positionArray);
-                geometry->accept(*this);
             }
         }
     }
-    else
+
+    // prepares the billboard geometries ahead of a parallel traversal, as the geometries may be shared with subgraphs other threads are reading
+    class PrepareBillboardGeometries : public osg::NodeVisitor
     {
-        for(unsigned int i=0; i<billboard.getNumDrawables(); ++i)
+    public:
+        PrepareBillboardGeometries(const osg::NodeVisitor& nv) :
+            osg::NodeVisitor(nv.getTraversalMode())
         {
-            auto translate = osg::Matrixd::translate(billboard.getPosition(i));
+            setTraversalMask(nv.getTraversalMask());
+            setNodeMaskOverride(nv.getNodeMaskOverride());
+        }
 
-            if (matrixstack.empty()) pushMatrix(translate);
+        void apply(osg::Billboard& billboard) override
+        {
+            prepareBillboardGeometries(billboard);
+        }
+    };
+}
+
+void SceneBuilder::apply(osg::Billboard& billboard)
+{
+    DEBUG_OUTPUT<<"apply(osg::Billboard& billboard)"<<std::endl;
+
+    if (billboard.getStateSet()) pushStateSet(*billboard.getStateSet());
+
+    if (buildOptions->billboardTransform)
+    {
+        nodeShaderModeMasks = BILLBOARD;
+    }
+    else
+    {
+        nodeShaderModeMasks = BILLBOARD | SHADER_TRANSLATE;
+    }
+
+
+    if (nodeShaderModeMasks & SHADER_TRANSLATE)
+    {
+        // when traversing in parallel the geometries have already been prepared by traverseInParallel(..)
+        if (!billboardGeometriesPrepared) prepareBillboardGeometries(billboard);
+
+        std::set<osg::Drawable*> drawables;
+        for(unsigned int i=0; i<billboard.getNumDrawables(); ++i)
+        {
+            osg::Geometry* geometry = billboard.getDrawable(i)->asGeometry();
+            if (geometry && drawables.insert(geometry).second) geometry->accept(*this);
+        }
+    }
+    else
+    {
+        for(unsigned int i=0; i<billboard.getNumDrawables(); ++i)
+        {
+            auto translate = osg::Matrixd::translate(billboard.getPosition(i));
+
+            if (matrixstack.empty()) pushMatrix(translate);
             else pushMatrix(translate * matrixstack.back());
 
             billboard.getDrawable(i)->accept(*this);
@@ -480,14 +1015,16 @@ void SceneBuilder::apply(osg::Geometry& geometry)
     osg::Matrix matrix;
     if (!matrixstack.empty()) matrix = matrixstack.back();
 
+    MatrixKey matrixKey(matrix, buildOptions->matrixTolerance, buildOptions->matrixTranslationTolerance);
+
     // Build programTransformStateMap
     {
         TransformStatePair& transformStatePair = programTransformStateMap[statePair.first];
-        StateGeometryMap& stateGeometryMap = transformStatePair.matrixStateGeometryMap[matrix];
+        StateGeometryMap& stateGeometryMap = transformStatePair.matrixStateGeometryMap[matrixKey];
         stateGeometryMap[statePair.second].push_back(&geometry);
 
         TransformGeometryMap& transformGeometryMap = transformStatePair.stateTransformMap[statePair.second];
-        transformGeometryMap[matrix].push_back(&geometry);
+        transformGeometryMap[matrixKey].push_back(&geometry);
     }
 
     // Build new masksTransformStateMap
@@ -497,36 +1034,188 @@ void SceneBuilder::apply(osg::Geometry& geometry)
         DEBUG_OUTPUT<<"populating masks ("<<masks.first<<", "<<masks.second<<")"<<std::endl;
 
         TransformStatePair& transformStatePair = masksTransformStateMap[masks];
-        StateGeometryMap& stateGeometryMap = transformStatePair.matrixStateGeometryMap[matrix];
+        StateGeometryMap& stateGeometryMap = transformStatePair.matrixStateGeometryMap[matrixKey];
         stateGeometryMap[statePair.second].push_back(&geometry);
 
         TransformGeometryMap& transformGeometryMap = transformStatePair.stateTransformMap[statePair.second];
-        transformGeometryMap[matrix].push_back(&geometry);
+        transformGeometryMap[matrixKey].push_back(&geometry);
     }
 
-    DEBUG_OUTPUT<<"   Geometry "<<geometry.className()<<" ss="<<statestack.size()<<" ms="<<matrixstack.size()<<std::endl;
+    DEBUG_OUTPUT<<"   Geometry "<<geometry.className()<<" ss="<<stateStackDepth()<<" ms="<<matrixstack.size()<<std::endl;
 
     if (geometry.getStateSet()) popStateSet();
 }
 
-void SceneBuilder::pushStateSet(osg::StateSet& stateset)
+void SceneBuilder::SceneBuilder::pushMatrix(const osg::Matrix& matrix)
 {
-    statestack.push_back(&stateset);
+    matrixstack.push_back(matrix);
 }
 
-void SceneBuilder::popStateSet()
+void SceneBuilder::popMatrix()
 {
-    statestack.pop_back();
+    matrixstack.pop_back();
 }
 
-void SceneBuilder::SceneBuilder::pushMatrix(const osg::Matrix& matrix)
+void SceneBuilder::traverseInParallel(osg::Node& node)
 {
-    matrixstack.push_back(matrix);
+    auto instrumentation = buildOptions->instrumentation.get();
+    ScopedTiming timing(instrumentation, "scene traversal");
+
+    uint32_t numThreads = buildOptions->numThreads;
+    if (numThreads<=1)
+    {
+        node.accept(*this);
+        return;
+    }
+
+    // groups are split without being accepted, so the nodes the serial traversal would skip have to be left out here
+    if (!validNodeMask(node)) return;
+
+    // subgraph along with the statesets and matrix it inherits from its ancestors
+    struct Subgraph
+    {
+        osg::ref_ptr<osg::Node> node;
+        std::vector<osg::ref_ptr<osg::StateSet>> statesets;
+        bool hasMatrix = false;
+        osg::Matrix matrix;
+    };
+
+    Subgraph root;
+    root.node = &node;
+    for(auto stateNode = currentStateNode; stateNode->parent; stateNode = stateNode->parent)
+    {
+        root.statesets.insert(root.statesets.begin(), stateNode->stateset);
+    }
+    root.hasMatrix = !matrixstack.empty();
+    if (root.hasMatrix) root.matrix = matrixstack.back();
+
+    // split groups into their children, a level at a time, until there are enough subgraphs to keep the threads busy.
+    // Only groups and transforms that traverse all their children are split, Switch, LOD, Geode etc. are left to the SceneBuilders.
+    const size_t targetNumSubgraphs = numThreads * 4;
+    std::vector<Subgraph> subgraphs{root};
+    bool split = true;
+    while(split && subgraphs.size()<targetNumSubgraphs)
+    {
+        split = false;
+
+        std::vector<Subgraph> nextSubgraphs;
+        for(auto& subgraph : subgraphs)
+        {
+            osg::Group* group = subgraph.node->asGroup();
+            osg::Transform* transform = subgraph.node->asTransform();
+            if (!group || group->getNumChildren()==0 || (!transform && typeid(*group)!=typeid(osg::Group)))
+            {
+                nextSubgraphs.push_back(subgraph);
+                continue;
+            }
+
+            split = true;
+
+            Subgraph inherited = subgraph;
+            if (group->getStateSet()) inherited.statesets.push_back(group->getStateSet());
+            if (transform)
+            {
+                osg::Matrix matrix;
+                if (subgraph.hasMatrix) matrix = subgraph.matrix;
+                transform->computeLocalToWorldMatrix(matrix, this);
+
+                inherited.hasMatrix = true;
+                inherited.matrix = matrix;
+            }
+
+            for(unsigned int i=0; i<group->getNumChildren(); ++i)
+            {
+                if (!validNodeMask(*group->getChild(i))) continue;
+
+                inherited.node = group->getChild(i);
+                nextSubgraphs.push_back(inherited);
+            }
+        }
+        subgraphs.swap(nextSubgraphs);
+    }
+
+    DEBUG_OUTPUT<<"traverseInParallel() split into "<<subgraphs.size()<<" subgraphs"<<std::endl;
+
+    // the SHADER_TRANSLATE billboards modify their geometries, which other threads may be reading, so modify them all up front
+    if (!buildOptions->billboardTransform)
+    {
+        PrepareBillboardGeometries prepareBillboardGeometries(*this);
+        for(auto& subgraph : subgraphs) subgraph.node->accept(prepareBillboardGeometries);
+    }
+
+    // traverse contiguous ranges of the subgraphs with a SceneBuilder each, so merging the ranges in order preserves the traversal order
+    size_t numRanges = std::min(subgraphs.size(), targetNumSubgraphs);
+    std::vector<std::unique_ptr<SceneBuilder>> builders(numRanges);
+
+    parallelFor(numThreads, numRanges, [&](size_t range)
+    {
+        ScopedTiming rangeTiming(instrumentation, "subgraph traversal");
+
+        auto builder = std::make_unique<SceneBuilder>(buildOptions);
+        builder->setTraversalMask(getTraversalMask());
+        builder->setNodeMaskOverride(getNodeMaskOverride());
+        builder->billboardGeometriesPrepared = true;
+
+        size_t begin = range * subgraphs.size() / numRanges;
+        size_t end = (range + 1) * subgraphs.size() / numRanges;
+        for(size_t i=begin; i<end; ++i)
+        {
+            auto& subgraph = subgraphs[i];
+
+            for(auto& stateset : subgraph.statesets) builder->pushStateSet(*stateset);
+            if (subgraph.hasMatrix) builder->pushMatrix(subgraph.matrix);
+
+            subgraph.node->accept(*builder);
+
+            if (subgraph.hasMatrix) builder->popMatrix();
+            for(size_t s=0; s<subgraph.statesets.size(); ++s) builder->popStateSet();
+        }
+
+        builders[range] = std::move(builder);
+    });
+
+    // merging looks up the statesets collected by each builder in this builder's unique statesets
+    ScopedTiming mergeTiming(instrumentation, "state uniquing");
+    for(auto& builder : builders)
+    {
+        merge(*builder);
+    }
 }
 
-void SceneBuilder::popMatrix()
+void SceneBuilder::merge(SceneBuilder& builder)
 {
-    matrixstack.pop_back();
+    auto mergeTransformStatePair = [&](TransformStatePair& dest, TransformStatePair& src)
+    {
+        for(auto& [matrix, stateGeometryMap] : src.matrixStateGeometryMap)
+        {
+            auto& destStateGeometryMap = dest.matrixStateGeometryMap[MatrixKey(matrix, buildOptions->matrixTolerance, buildOptions->matrixTranslationTolerance)];
+            for(auto& [stateset, geometries] : stateGeometryMap)
+            {
+                auto& destGeometries = destStateGeometryMap[uniqueState(stateset, false)];
+                destGeometries.insert(destGeometries.end(), geometries.begin(), geometries.end());
+            }
+        }
+
+        for(auto& [stateset, transformGeometryMap] : src.stateTransformMap)
+        {
+            auto& destTransformGeometryMap = dest.stateTransformMap[uniqueState(stateset, false)];
+            for(auto& [matrix, geometries] : transformGeometryMap)
+            {
+                auto& destGeometries = destTransformGeometryMap[MatrixKey(matrix, buildOptions->matrixTolerance, buildOptions->matrixTranslationTolerance)];
+                destGeometries.insert(destGeometries.end(), geometries.begin(), geometries.end());
+            }
+        }
+    };
+
+    for(auto& [programStateSet, transformStatePair] : builder.programTransformStateMap)
+    {
+        mergeTransformStatePair(programTransformStateMap[uniqueState(programStateSet, true)], transformStatePair);
+    }
+
+    for(auto& [masks, transformStatePair] : builder.masksTransformStateMap)
+    {
+        mergeTransformStatePair(masksTransformStateMap[masks], transformStatePair);
+    }
 }
 
 void SceneBuilder::print()
@@ -647,6 +1336,47 @@ osg::ref_ptr<osg::Node> SceneBuilder::createOSG()
     return group;
 }
 
+static vsg::sphere computeBoundingSphere(const osg::BoundingSphere& bs)
+{
+    return vsg::sphere(vsg::vec3(bs.center().x(), bs.center().y(), bs.center().z()), bs.radius());
+}
+
+void SceneBuilder::applyCullCostModel(CullCandidates& cullCandidates)
+{
+    // the candidates share a parent, the subgraph of their state group
+    osg::BoundingBox parent_bb;
+    std::vector<vsg::sphere> spheres;
+    for (auto& candidate : cullCandidates)
+    {
+        auto& bound = candidate.bound;
+        parent_bb.expandBy(osg::BoundingSphere(osg::Vec3(bound.center.x, bound.center.y, bound.center.z), bound.radius));
+        spheres.push_back(bound);
+    }
+    float parentRadius = parent_bb.valid() ? parent_bb.radius() : 0.0f;
+
+    auto overlaps = countOverlaps(spheres);
+
+    auto& model = buildOptions->cullCostModel;
+    CullCostStats stats;
+    for (size_t i = 0; i < cullCandidates.size(); ++i)
+    {
+        auto& candidate = cullCandidates[i];
+        float savings = model.expectedDrawSavings(candidate.numTriangles, candidate.bound.radius, parentRadius, overlaps[i]);
+        candidate.cull = savings > model.cullTestCost;
+
+        ++stats.numCandidates;
+        if (candidate.cull)
+        {
+            ++stats.numCullNodes;
+            stats.expectedCullCost += model.cullTestCost;
+            stats.expectedDrawSavings += savings;
+        }
+    }
+
+    std::scoped_lock<std::mutex> lock(cullCostStatsMutex);
+    cullCostStats.add(stats);
+}
+
 vsg::ref_ptr<vsg::Node> SceneBuilder::createTransformGeometryGraphVSG(TransformGeometryMap& transformGeometryMap, vsg::Paths& /*searchPaths*/, uint32_t requiredGeomAttributesMask)
 {
     DEBUG_OUTPUT << "createTransformGeometryGraphVSG() " << transformGeometryMap.size() << std::endl;
@@ -654,6 +1384,43 @@ vsg::ref_ptr<vsg::Node> SceneBuilder::createTransformGeometryGraphVSG(TransformG
     if (transformGeometryMap.empty()) return vsg::ref_ptr<vsg::Node>();
 
     vsg::ref_ptr<vsg::Group> group = vsg::Group::create();
+
+    // with a spatial hierarchy the culled children are collected and placed in a BVH of CullGroups rather than directly in group
+    bool useSpatialHierarchy = buildOptions->spatialHierarchyLeafSize > 0 && (buildOptions->insertCullGroups || buildOptions->insertCullNodes);
+    BoundedNodes boundedNodes;
+    auto addCulledChild = [&](const vsg::sphere& bound, vsg::ref_ptr<vsg::Node> child)
+    {
+        if (useSpatialHierarchy) boundedNodes.push_back(BoundedNode{bound, child});
+        else group->addChild(child);
+    };
+
+    // the subgraphs that may be culled, a transform with its geometries or a geometry without a transform, in the order they are visited below
+    CullCandidates cullCandidates;
+    bool insertCulling = buildOptions->insertCullGroups || buildOptions->insertCullNodes;
+    if (insertCulling)
+    {
+        for (auto& [matrix, geometries] : transformGeometryMap)
+        {
+            if (!matrix.isIdentity())
+            {
+                uint32_t numTriangles = 0;
+                for (auto& geometry : geometries) numTriangles += computeNumTriangles(geometry.get());
+
+                cullCandidates.push_back(CullCandidate{computeBoundingSphere(boundsCache.computeBound(geometries, matrix)), numTriangles, true});
+            }
+            else
+            {
+                for (auto& geometry : geometries)
+                {
+                    cullCandidates.push_back(CullCandidate{computeBoundingSphere(boundsCache.getBounds(geometry.get()).sphere), computeNumTriangles(geometry.get()), true});
+                }
+            }
+        }
+
+        if (buildOptions->useCullCostModel) applyCullCostModel(cullCandidates);
+    }
+    size_t candidateIndex = 0;
+
     for (auto[matrix, geometries] : transformGeometryMap)
     {
         vsg::ref_ptr<vsg::Group> localGroup = group;
@@ -661,8 +1428,6 @@ vsg::ref_ptr<vsg::Node> SceneBuilder::createTransformGeometryGraphVSG(TransformG
         bool requiresTransform = !matrix.isIdentity();
 
 #if 1
-        bool requiresTopCullGroup = (buildOptions->insertCullGroups || buildOptions->insertCullNodes) && (requiresTransform/* || geometries.size()==1*/);
-        bool requiresLeafCullGroup = (buildOptions->insertCullGroups || buildOptions->insertCullNodes) && !requiresTopCullGroup;
         if (requiresTransform)
         {
             // need to insert a transform
@@ -675,32 +1440,18 @@ vsg::ref_ptr<vsg::Node> SceneBuilder::createTransformGeometryGraphVSG(TransformG
 
             localGroup = transform;
 
-
-            if (buildOptions->insertCullGroups || buildOptions->insertCullNodes)
+            if (insertCulling && cullCandidates[candidateIndex++].cull)
             {
-                osg::BoundingBox overall_bb;
-                for (auto& geometry : geometries)
-                {
-                    osg::BoundingBox bb = geometry->getBoundingBox();
-                    for(int i=0; i<8; ++i)
-                    {
-                        overall_bb.expandBy(bb.corner(i) * matrix);
-                    }
-                }
-
-                vsg::vec3 bb_min(overall_bb.xMin(), overall_bb.yMin(), overall_bb.zMin());
-                vsg::vec3 bb_max(overall_bb.xMax(), overall_bb.yMax(), overall_bb.zMax());
-                vsg::sphere boundingSphere((bb_min + bb_max)*0.5f, vsg::length(bb_max - bb_min)*0.5f);
-
+                auto& boundingSphere = cullCandidates[candidateIndex-1].bound;
                 if (buildOptions->insertCullNodes)
                 {
-                    group->addChild(vsg::CullNode::create(boundingSphere, transform));
+                    addCulledChild(boundingSphere, vsg::CullNode::create(boundingSphere, transform));
                 }
                 else
                 {
                     auto cullGroup = vsg::CullGroup::create(boundingSphere);
                     cullGroup->addChild(transform);
-                    group->addChild(cullGroup);
+                    addCulledChild(boundingSphere, cullGroup);
                 }
             }
             else
@@ -753,39 +1504,31 @@ vsg::ref_ptr<vsg::Node> SceneBuilder::createTransformGeometryGraphVSG(TransformG
         for (auto& geometry : geometries)
         {
 #if 1
+            // the converted arrays depend on the attributes the pipeline requires, so geometries are only shared between the same masks
+            GeometryKey geometryKey(geometry.get(), requiredGeomAttributesMask);
+
+            // the geometries are converted by convertGeometries() before the subgraphs are built, so the geometriesMap is only read here
             vsg::ref_ptr<vsg::Command> leaf;
-            if(geometriesMap.find(geometry) != geometriesMap.end())
+            if (auto itr = geometriesMap.find(geometryKey); itr != geometriesMap.end())
             {
                 DEBUG_OUTPUT << "sharing geometry" << std::endl;
-                leaf = geometriesMap[geometry];
-            }
-            else
-            {
-                leaf = convertToVsg(geometry, requiredGeomAttributesMask, buildOptions->geometryTarget);
-                if (leaf)
-                {
-                    geometriesMap[geometry] = leaf;
-                }
+                leaf = itr->second;
             }
 
-            if (requiresLeafCullGroup)
+            if (insertCulling && !requiresTransform && cullCandidates[candidateIndex++].cull)
             {
-                osg::BoundingBox bb = geometry->getBoundingBox();
-                vsg::vec3 bb_min(bb.xMin(), bb.yMin(), bb.zMin());
-                vsg::vec3 bb_max(bb.xMax(), bb.yMax(), bb.zMax());
-
-                vsg::sphere boundingSphere((bb_min + bb_max)*0.5f, vsg::length(bb_max - bb_min)*0.5f);
+                auto& boundingSphere = cullCandidates[candidateIndex-1].bound;
                 if (buildOptions->insertCullNodes)
                 {
                     DEBUG_OUTPUT<<"Using CullNode"<<std::endl;
-                    localGroup->addChild( vsg::CullNode::create(boundingSphere, leaf) );
+                    addCulledChild(boundingSphere, vsg::CullNode::create(boundingSphere, leaf));
                 }
                 else
                 {
                     DEBUG_OUTPUT<<"Using CullGroupe"<<std::endl;
                     auto cullGroup = vsg::CullGroup::create(boundingSphere);
                     cullGroup->addChild(leaf);
-                    localGroup->addChild(cullGroup);
+                    addCulledChild(boundingSphere, cullGroup);
                 }
             }
             else
@@ -811,10 +1554,11 @@ vsg::ref_ptr<vsg::Node> SceneBuilder::createTransformGeometryGraphVSG(TransformG
             }
 
             // has the geometry already been converted
-            if(geometriesMap.find(geometry) != geometriesMap.end())
+            GeometryKey geometryKey(geometry.get(), requiredGeomAttributesMask);
+            if(geometriesMap.find(geometryKey) != geometriesMap.end())
             {
                 DEBUG_OUTPUT << "sharing geometry" << std::endl;
-                nestedGroup->addChild(vsg::ref_ptr<vsg::Node>(geometriesMap[geometry]));
+                nestedGroup->addChild(vsg::ref_ptr<vsg::Node>(geometriesMap[geometryKey]));
             }
             else
             {
@@ -822,25 +1566,499 @@ vsg::ref_ptr<vsg::Node> SceneBuilder::createTransformGeometryGraphVSG(TransformG
                 if (new_geometry)
                 {
                     nestedGroup->addChild(new_geometry);
-                    geometriesMap[geometry] = new_geometry;
+                    geometriesMap[geometryKey] = new_geometry;
                 }
             }
 #endif
         }
     }
 
+    if (!boundedNodes.empty())
+    {
+        group->addChild(createSpatialHierarchy(boundedNodes, buildOptions->spatialHierarchyLeafSize, buildOptions->spatialHierarchySplitMethod));
+    }
+
     if (group->getNumChildren() == 1) return vsg::ref_ptr<vsg::Node>(group->getChild(0));
 
     return group;
 }
 
+SceneBuilder::Masks SceneBuilder::computeBuildMasks(const Masks& masks) const
+{
+    uint32_t geometrymask = (masks.second | buildOptions->overrideGeomAttributes) & buildOptions->supportedGeometryAttributes;
+    uint32_t shaderModeMask = (masks.first | buildOptions->overrideShaderModeMask) & buildOptions->supportedShaderModeMask;
+
+    // collapse the combinations that would produce identical pipelines
+    bool builtInShaders = buildOptions->vertexShaderPath.empty() && buildOptions->fragmentShaderPath.empty();
+    std::tie(shaderModeMask, geometrymask) = canonicalizeShaderMasks(shaderModeMask, geometrymask, builtInShaders);
+
+    if (shaderModeMask & NORMAL_MAP) geometrymask |= TANGENT; // mesh propably won't have tangets so force them on if we want Normal mapping
+
+    // only the built in fbx shaders support reading the material from the storage buffer, and the device has to have room for the material index push constant
+    bool materialStorageBuffer = buildOptions->materialStorageBuffer && builtInShaders && !buildOptions->pipelineCache->useSpecializationConstants && buildOptions->pipelineCache->supportsMaterialStorageBuffer();
+    if (materialStorageBuffer && (shaderModeMask & MATERIAL)) shaderModeMask |= MATERIAL_STORAGE_BUFFER;
+    else shaderModeMask &= ~MATERIAL_STORAGE_BUFFER;
+
+    // likewise for selecting the texture maps from the bindless texture array, falling back to a binding per texture unit when the device can't support it
+    bool bindlessTextures = buildOptions->bindlessTextures && builtInShaders && !buildOptions->pipelineCache->useSpecializationConstants && buildOptions->pipelineCache->supportsBindlessTextures();
+    if (bindlessTextures && (shaderModeMask & (DIFFUSE_MAP | OPACITY_MAP | AMBIENT_MAP | NORMAL_MAP | SPECULAR_MAP))) shaderModeMask |= BINDLESS_TEXTURES;
+    else shaderModeMask &= ~BINDLESS_TEXTURES;
+
+    return Masks(shaderModeMask, geometrymask);
+}
+
+void SceneBuilder::mergeEquivalentPipelines()
+{
+    // rekey masksTransformStateMap by the build masks, computeBuildMasks(..) is idempotent so this is safe to repeat
+    MasksTransformStateMap mergedMap;
+    numRawPipelines = 0;
+    for (auto& [masks, transformStatePair] : masksTransformStateMap)
+    {
+        if (transformStatePair.stateTransformMap.empty()) continue;
+
+        ++numRawPipelines;
+
+        auto& merged = mergedMap[computeBuildMasks(masks)];
+        for (auto& [matrix, stateGeometryMap] : transformStatePair.matrixStateGeometryMap)
+        {
+            for (auto& [stateset, geometries] : stateGeometryMap)
+            {
+                auto& mergedGeometries = merged.matrixStateGeometryMap[MatrixKey(matrix, buildOptions->matrixTolerance, buildOptions->matrixTranslationTolerance)][stateset];
+                mergedGeometries.insert(mergedGeometries.end(), geometries.begin(), geometries.end());
+            }
+        }
+
+        for (auto& [stateset, transformGeometryMap] : transformStatePair.stateTransformMap)
+        {
+            for (auto& [matrix, geometries] : transformGeometryMap)
+            {
+                auto& mergedGeometries = merged.stateTransformMap[stateset][MatrixKey(matrix, buildOptions->matrixTolerance, buildOptions->matrixTranslationTolerance)];
+                mergedGeometries.insert(mergedGeometries.end(), geometries.begin(), geometries.end());
+            }
+        }
+    }
+
+    masksTransformStateMap.swap(mergedMap);
+    numPipelines = masksTransformStateMap.size();
+
+    DEBUG_OUTPUT<<"mergeEquivalentPipelines() "<<numRawPipelines<<" mask combinations merged into "<<numPipelines<<" pipelines"<<std::endl;
+}
+
+void SceneBuilder::convertGeometries()
+{
+    // collect the attribute masks each geometry is required with, so each geometry is converted by a single thread.
+    // Every geometry gets an entry, even those already converted, so that all their bounds are cached below.
+    std::map<osg::Geometry*, std::set<uint32_t>> geometryMasks;
+    for (auto& [masks, transformStatePair] : masksTransformStateMap)
+    {
+        uint32_t geometryMask = computeBuildMasks(masks).second;
+        for (auto& [stateset, transformGeometryMap] : transformStatePair.stateTransformMap)
+        {
+            for (auto& [matrix, geometries] : transformGeometryMap)
+            {
+                for (auto& geometry : geometries)
+                {
+                    auto& masksToConvert = geometryMasks[geometry.get()];
+                    if (geometriesMap.count(GeometryKey(geometry.get(), geometryMask))==0) masksToConvert.insert(geometryMask);
+                }
+            }
+        }
+    }
+
+    std::vector<std::pair<osg::Geometry*, std::set<uint32_t>>> geometries(geometryMasks.begin(), geometryMasks.end());
+    std::vector<std::vector<vsg::ref_ptr<vsg::Command>>> converted(geometries.size());
+
+    auto instrumentation = buildOptions->instrumentation.get();
+    parallelFor(buildOptions->numThreads, geometries.size(), [&](size_t i)
+    {
+        ScopedTiming timing(instrumentation, "geometry conversion");
+
+        osg::Geometry* geometry = geometries[i].first;
+
+        // osg::Drawable computes and caches its bounding box on first use, so compute it and the tighter bounds here where only this thread
+        // accesses the geometry. The parallel tasks that build the subgraphs then only read the BoundsCache.
+        boundsCache.getBounds(geometry);
+
+        for (auto geometryMask : geometries[i].second)
+        {
+            converted[i].push_back(convertToVsg(geometry, geometryMask, buildOptions->geometryTarget, instrumentation));
+        }
+    });
+
+    size_t numConverted = std::count_if(geometries.begin(), geometries.end(), [](auto& entry) { return !entry.second.empty(); });
+    count(instrumentation, "geometries converted", static_cast<int64_t>(numConverted));
+
+    for (size_t i = 0; i < geometries.size(); ++i)
+    {
+        auto leaf = converted[i].begin();
+        for (auto geometryMask : geometries[i].second)
+        {
+            if (*leaf) geometriesMap[GeometryKey(geometries[i].first, geometryMask)] = *leaf;
+            ++leaf;
+        }
+    }
+
+    DEBUG_OUTPUT<<"convertGeometries() converted "<<numConverted<<" geometries"<<std::endl;
+}
+
+float StateChangeStats::cost(const StateChangeCosts& costs) const
+{
+    return costs.pipeline * pipelines + costs.descriptorSet * descriptorSets + costs.vertexBuffers * vertexBuffers + costs.pushConstants * pushConstants;
+}
+
+void StateChangeStats::print(std::ostream& out, const StateChangeCosts& costs) const
+{
+    out<<"pipelines "<<pipelines<<", descriptor sets "<<descriptorSets<<", vertex buffers "<<vertexBuffers<<", push constants "<<pushConstants<<", cost "<<cost(costs)<<std::endl;
+}
+
+// the subgraphs grouped by parent, opaque before blended, and then by pipeline in order of first use, as attachStateSubgraphs(..) attaches them
+using PipelineSubgraphs = std::vector<std::pair<const vsg::BindGraphicsPipeline*, std::vector<const SceneBuilder::StateSubgraph*>>>;
+
+static std::vector<PipelineSubgraphs> groupStateSubgraphs(const SceneBuilder::StateSubgraphs& stateSubgraphs)
+{
+    std::vector<const vsg::Group*> parents;
+    std::map<const vsg::Group*, PipelineSubgraphs> parentPipelines;
+    for (int blend = 0; blend < 2; ++blend)
+    {
+        for (auto& stateSubgraph : stateSubgraphs)
+        {
+            if (stateSubgraph.blend != (blend == 1)) continue;
+
+            auto parent = stateSubgraph.parent.get();
+            auto [itr, inserted] = parentPipelines.try_emplace(parent);
+            if (inserted) parents.push_back(parent);
+
+            auto& pipelines = itr->second;
+            auto pipeline = stateSubgraph.bindGraphicsPipeline.get();
+            auto pipelineItr = std::find_if(pipelines.begin(), pipelines.end(), [&](auto& entry) { return entry.first == pipeline; });
+            if (pipelineItr == pipelines.end()) pipelineItr = pipelines.insert(pipelines.end(), {pipeline, {}});
+            pipelineItr->second.push_back(&stateSubgraph);
+        }
+    }
+
+    std::vector<PipelineSubgraphs> groups;
+    for (auto parent : parents) groups.push_back(std::move(parentPipelines[parent]));
+    return groups;
+}
+
+namespace
+{
+    // counts the binds recording a graph makes when nothing is culled, following vsg::State: a StateGroup's commands are
+    // bound before the next draw below it each time it is traversed, and the enclosing StateGroup's again after it is popped
+    class StateChangeCounter : public vsg::ConstVisitor
+    {
+    public:
+        StateChangeStats stats;
+
+        void apply(const vsg::Object& object) override
+        {
+            object.traverse(*this);
+        }
+
+        void apply(const vsg::StateGroup& stategroup) override
+        {
+            uint32_t counts[NUM_CATEGORIES] = {0, 0, 0};
+            for (auto& command : stategroup.getStateCommands())
+            {
+                auto object = static_cast<const vsg::Object*>(command.get());
+                if (dynamic_cast<const vsg::BindGraphicsPipeline*>(object)) ++counts[PIPELINES];
+                else if (dynamic_cast<const vsg::BindDescriptorSet*>(object) || dynamic_cast<const vsg::BindDescriptorSets*>(object)) ++counts[DESCRIPTOR_SETS];
+                else if (dynamic_cast<const vsg::PushConstants*>(object)) ++counts[PUSH_CONSTANTS];
+            }
+
+            for (int category = 0; category < NUM_CATEGORIES; ++category)
+            {
+                if (counts[category] == 0) continue;
+                _stacks[category].push_back(counts[category]);
+                _dirty[category] = true;
+            }
+
+            stategroup.traverse(*this);
+
+            for (int category = 0; category < NUM_CATEGORIES; ++category)
+            {
+                if (counts[category] == 0) continue;
+                _stacks[category].pop_back();
+                _dirty[category] = true;
+            }
+        }
+
+        // each draw binds its own vertex arrays
+        void apply(const vsg::Geometry&) override { draw(); }
+        void apply(const vsg::VertexIndexDraw&) override { draw(); }
+        void apply(const vsg::BindVertexBuffers&) override { draw(); }
+
+    protected:
+        enum Category
+        {
+            PIPELINES,
+            DESCRIPTOR_SETS,
+            PUSH_CONSTANTS,
+            NUM_CATEGORIES
+        };
+
+        void draw()
+        {
+            uint32_t* binds[NUM_CATEGORIES] = {&stats.pipelines, &stats.descriptorSets, &stats.pushConstants};
+            for (int category = 0; category < NUM_CATEGORIES; ++category)
+            {
+                if (_dirty[category] && !_stacks[category].empty()) *binds[category] += _stacks[category].back();
+                _dirty[category] = false;
+            }
+            ++stats.vertexBuffers;
+        }
+
+        std::vector<uint32_t> _stacks[NUM_CATEGORIES];
+        bool _dirty[NUM_CATEGORIES] = {false, false, false};
+    };
+}
+
+StateChangeStats SceneBuilder::countStateChanges(const vsg::Node& node) const
+{
+    StateChangeCounter counter;
+    node.accept(counter);
+    return counter.stats;
+}
+
+void SceneBuilder::attachStateSubgraphs(const StateSubgraphs& stateSubgraphs) const
+{
+    // the pipeline layouts are interned, so a descriptor set used by several pipelines can be bound once above all of them,
+    // as Vulkan keeps descriptor sets bound across pipeline binds with compatible layouts
+    using DescriptorSetUse = std::tuple<const vsg::Group*, const vsg::PipelineLayout*, const vsg::DescriptorSet*>;
+    std::map<DescriptorSetUse, std::set<const vsg::BindGraphicsPipeline*>> descriptorSetPipelines;
+    for (auto& stateSubgraph : stateSubgraphs)
+    {
+        if (!stateSubgraph.descriptorSet) continue;
+
+        vsg::ref_ptr<vsg::PipelineLayout> pipelineLayout(stateSubgraph.bindGraphicsPipeline->getPipeline()->getPipelineLayout());
+        descriptorSetPipelines[DescriptorSetUse(stateSubgraph.parent.get(), pipelineLayout.get(), stateSubgraph.descriptorSet.get())].insert(stateSubgraph.bindGraphicsPipeline.get());
+    }
+
+    std::map<std::pair<const vsg::PipelineLayout*, const vsg::DescriptorSet*>, vsg::ref_ptr<vsg::StateCommand>> bindDescriptorSetMap;
+    auto getOrCreateBindDescriptorSet = [&](vsg::ref_ptr<vsg::PipelineLayout> pipelineLayout, vsg::ref_ptr<vsg::DescriptorSet> descriptorSet)
+    {
+        auto& bindDescriptorSet = bindDescriptorSetMap[std::make_pair(pipelineLayout.get(), descriptorSet.get())];
+        if (!bindDescriptorSet)
+        {
+            if (buildOptions->useBindDescriptorSet) bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, descriptorSet);
+            else bindDescriptorSet = vsg::BindDescriptorSets::create(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, vsg::DescriptorSets{descriptorSet});
+        }
+        return bindDescriptorSet;
+    };
+
+    // vsg::State binds a StateGroup's commands each time the StateGroup is traversed, so consecutive subgraphs with the same bind
+    // share the parent's last StateGroup, and otherwise a new StateGroup is appended so the order of the subgraphs is kept
+    std::map<const vsg::Group*, vsg::ref_ptr<vsg::StateGroup>> lastStateGroups;
+    auto getOrCreateStateGroup = [&](vsg::ref_ptr<vsg::Group> parent, vsg::ref_ptr<vsg::StateCommand> stateCommand)
+    {
+        auto& stateGroup = lastStateGroups[parent.get()];
+        if (!stateGroup || stateGroup->getStateCommands().front() != stateCommand || parent->getChildren().back().get() != stateGroup.get())
+        {
+            stateGroup = vsg::StateGroup::create();
+            stateGroup->add(stateCommand);
+            parent->addChild(stateGroup);
+        }
+        return stateGroup;
+    };
+
+    for (auto& pipelines : groupStateSubgraphs(stateSubgraphs))
+    {
+        for (auto& [pipeline, subgraphs] : pipelines)
+        {
+            for (auto stateSubgraph : subgraphs)
+            {
+                vsg::ref_ptr<vsg::PipelineLayout> pipelineLayout(stateSubgraph->bindGraphicsPipeline->getPipeline()->getPipelineLayout());
+
+                if (!stateSubgraph->descriptorSet)
+                {
+                    getOrCreateStateGroup(stateSubgraph->parent, stateSubgraph->bindGraphicsPipeline)->addChild(stateSubgraph->subgraph);
+                    continue;
+                }
+
+                auto bindDescriptorSet = getOrCreateBindDescriptorSet(pipelineLayout, stateSubgraph->descriptorSet);
+
+                auto& descriptorSetUsers = descriptorSetPipelines[DescriptorSetUse(stateSubgraph->parent.get(), pipelineLayout.get(), stateSubgraph->descriptorSet.get())];
+                if (descriptorSetUsers.size() > 1)
+                {
+                    // descriptor set above the consecutive pipelines that share it
+                    auto descriptorSetGroup = getOrCreateStateGroup(stateSubgraph->parent, bindDescriptorSet);
+                    getOrCreateStateGroup(vsg::ref_ptr<vsg::Group>(descriptorSetGroup), stateSubgraph->bindGraphicsPipeline)->addChild(stateSubgraph->subgraph);
+                }
+                else
+                {
+                    auto graphicsPipelineGroup = getOrCreateStateGroup(stateSubgraph->parent, stateSubgraph->bindGraphicsPipeline);
+                    getOrCreateStateGroup(vsg::ref_ptr<vsg::Group>(graphicsPipelineGroup), bindDescriptorSet)->addChild(stateSubgraph->subgraph);
+                }
+            }
+        }
+    }
+}
+
+void SceneBuilder::sortStateSubgraphs(StateSubgraphs& stateSubgraphs) const
+{
+    auto& costs = buildOptions->stateChangeCosts;
+
+    // rank the descriptor sets and push constants by first use, so grouping them doesn't depend on pointer order
+    std::map<const vsg::DescriptorSet*, size_t> descriptorSetRanks;
+    std::map<std::vector<const vsg::PushConstants*>, size_t> pushConstantRanks;
+    for (auto& stateSubgraph : stateSubgraphs)
+    {
+        descriptorSetRanks.try_emplace(stateSubgraph.descriptorSet.get(), descriptorSetRanks.size());
+        pushConstantRanks.try_emplace(stateSubgraph.pushConstants, pushConstantRanks.size());
+    }
+
+    auto distance = [&](const StateSubgraph* stateSubgraph)
+    {
+        if (!buildOptions->frontToBackHint || stateSubgraph->blend || !stateSubgraph->bound.valid()) return 0.0;
+        auto& eye = buildOptions->eyePointHint;
+        osg::Vec3d center(stateSubgraph->bound.center());
+        return (center - osg::Vec3d(eye.x, eye.y, eye.z)).length() - stateSubgraph->bound.radius();
+    };
+
+    StateSubgraphs sorted;
+    sorted.reserve(stateSubgraphs.size());
+
+    const vsg::DescriptorSet* currentDescriptorSet = nullptr;
+    std::vector<const vsg::PushConstants*> currentPushConstants;
+
+    for (auto& pipelines : groupStateSubgraphs(stateSubgraphs))
+    {
+        // within a pipeline group the subgraphs by descriptor set and then push constants, front to back within the same state
+        for (auto& [pipeline, subgraphs] : pipelines)
+        {
+            std::stable_sort(subgraphs.begin(), subgraphs.end(), [&](const StateSubgraph* lhs, const StateSubgraph* rhs) {
+                auto lhsKey = std::make_tuple(descriptorSetRanks[lhs->descriptorSet.get()], pushConstantRanks[lhs->pushConstants], distance(lhs));
+                auto rhsKey = std::make_tuple(descriptorSetRanks[rhs->descriptorSet.get()], pushConstantRanks[rhs->pushConstants], distance(rhs));
+                return lhsKey < rhsKey;
+            });
+        }
+
+        // order the pipelines greedily, each time taking the pipeline that is cheapest to switch to from the state left by the previous one,
+        // starting it with the subgraphs that share the current descriptor set
+        std::vector<bool> used(pipelines.size(), false);
+        for (size_t n = 0; n < pipelines.size(); ++n)
+        {
+            size_t best = 0;
+            float bestCost = std::numeric_limits<float>::max();
+            for (size_t i = 0; i < pipelines.size(); ++i)
+            {
+                if (used[i]) continue;
+
+                auto& subgraphs = pipelines[i].second;
+                bool sharesDescriptorSet = std::any_of(subgraphs.begin(), subgraphs.end(), [&](auto subgraph) { return subgraph->descriptorSet && subgraph->descriptorSet.get() == currentDescriptorSet; });
+                auto first = sharesDescriptorSet ? *std::find_if(subgraphs.begin(), subgraphs.end(), [&](auto subgraph) { return subgraph->descriptorSet.get() == currentDescriptorSet; }) : subgraphs.front();
+
+                float cost = costs.pipeline;
+                if (first->descriptorSet && first->descriptorSet.get() != currentDescriptorSet) cost += costs.descriptorSet;
+                if (!first->pushConstants.empty() && first->pushConstants != currentPushConstants) cost += costs.pushConstants;
+
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    best = i;
+                }
+            }
+
+            used[best] = true;
+            auto& subgraphs = pipelines[best].second;
+            std::stable_partition(subgraphs.begin(), subgraphs.end(), [&](auto subgraph) { return subgraph->descriptorSet && subgraph->descriptorSet.get() == currentDescriptorSet; });
+
+            for (auto subgraph : subgraphs) sorted.push_back(*subgraph);
+
+            auto last = subgraphs.back();
+            if (last->descriptorSet) currentDescriptorSet = last->descriptorSet.get();
+            if (!last->pushConstants.empty()) currentPushConstants = last->pushConstants;
+        }
+    }
+
+    stateSubgraphs.swap(sorted);
+}
+
+void SceneBuilder::precompilePipelines()
+{
+    // collect the distinct pipeline masks, as different collected masks can map to the same build masks
+    std::set<Masks> uniqueMasks;
+    for (auto& [masks, transformStatePair] : masksTransformStateMap)
+    {
+        if (!transformStatePair.stateTransformMap.empty()) uniqueMasks.insert(computeBuildMasks(masks));
+    }
+
+    std::vector<Masks> buildMasks(uniqueMasks.begin(), uniqueMasks.end());
+
+    ScopedTiming timing(buildOptions->instrumentation.get(), "precompile pipelines");
+
+    DEBUG_OUTPUT<<"precompilePipelines() compiling "<<buildMasks.size()<<" pipelines with "<<buildOptions->numThreads<<" threads"<<std::endl;
+
+    auto& pipelineCache = buildOptions->pipelineCache;
+    parallelFor(buildOptions->numThreads, buildMasks.size(), [&](size_t i)
+    {
+        pipelineCache->getOrCreateBindGraphicsPipeline(buildMasks[i].first, buildMasks[i].second, buildOptions->vertexShaderPath, buildOptions->fragmentShaderPath);
+    });
+}
+
 vsg::ref_ptr<vsg::Node> SceneBuilder::createVSG(vsg::Paths& searchPaths)
 {
     DEBUG_OUTPUT<<"SceneBuilder::createVSG(vsg::Paths& searchPaths)"<<std::endl;
 
+    // the pipelines are created through the pipelineCache, so pass the instrumentation on to it and its shaderCompiler,
+    // assigning it even when null so a shared pipelineCache doesn't keep reporting to the sink of an earlier build
+    auto instrumentation = buildOptions->instrumentation.get();
+    buildOptions->pipelineCache->instrumentation = instrumentation;
+    buildOptions->pipelineCache->shaderCompiler->instrumentation = instrumentation;
+
+    ScopedTiming timing(instrumentation, "createVSG");
+
     // clear caches
     geometriesMap.clear();
+    boundsCache.clear();
     texturesMap.clear();
+    descriptorSetMap.clear();
+    materialIndices.clear();
+    materialIndexPushConstants.clear();
+    materialBufferDescriptor = nullptr;
+    textureIndices.clear();
+    bindlessTextureDescriptors.clear();
+    textureIndicesPushConstants.clear();
+
+    cullCostStats = CullCostStats();
+
+    // share pipelines between mask combinations that would produce identical pipelines
+    {
+        ScopedTiming mergeTiming(instrumentation, "merge pipelines");
+        mergeEquivalentPipelines();
+    }
+    count(instrumentation, "unique statesets", static_cast<int64_t>(uniqueStateSets.size()));
+    count(instrumentation, "pipelines", static_cast<int64_t>(numPipelines));
+
+    // compile all the shader variants up front so the pipeline lookups below are all cache hits
+    precompilePipelines();
+
+    // convert all the textures up front so that the conversions can be done in parallel, createVsgStateSet(..) then picks them up from the texturesMap.
+    // The materials are assigned their indices at the same time so the material storage buffer is complete before any descriptor sets use it.
+    {
+        Textures textures;
+        bool bindlessTextures = false;
+        for (auto& [masks, transformStatePair] : masksTransformStateMap)
+        {
+            uint32_t shaderModeMask = computeBuildMasks(masks).first;
+            if (shaderModeMask & BINDLESS_TEXTURES) bindlessTextures = true;
+
+            for (auto& stateTransform : transformStatePair.stateTransformMap)
+            {
+                collectTextures(stateTransform.first.get(), shaderModeMask, textures);
+                if (shaderModeMask & MATERIAL_STORAGE_BUFFER) getOrAssignMaterialIndex(stateTransform.first.get());
+            }
+        }
+
+        convertTextures(textures);
+        createMaterialBuffer();
+        if (bindlessTextures) assignTextureIndices(textures);
+    }
+
+    // convert the geometries up front in parallel, leaving createTransformGeometryGraphVSG(..) to pick them up from the geometriesMap
+    convertGeometries();
+
+    ScopedTiming assemblyTiming(instrumentation, "graph assembly");
 
     vsg::ref_ptr<vsg::Group> group = vsg::Group::create();
 
@@ -850,7 +2068,23 @@ vsg::ref_ptr<vsg::Node> SceneBuilder::createVSG(vsg::Paths& searchPaths)
     vsg::ref_ptr<vsg::Group> transparentGroup = vsg::Group::create();
     group->addChild(transparentGroup);
 
-    for (auto[masks, transformStatePair] : masksTransformStateMap)
+    // subgraphs to be placed below their pipeline and descriptor set binds
+    StateSubgraphs stateSubgraphs;
+
+    // the stateset subgraphs of each pipeline, collected in map order so the children are added in a deterministic order however they are built
+    struct StateSetSubgraph
+    {
+        vsg::ref_ptr<vsg::Group> parent;
+        vsg::ref_ptr<vsg::BindGraphicsPipeline> bindGraphicsPipeline;
+        uint32_t shaderModeMask;
+        uint32_t geometryMask;
+        osg::ref_ptr<osg::StateSet> stateset;
+        TransformGeometryMap* transformGeometryMap;
+        vsg::ref_ptr<vsg::Node> subgraph;
+    };
+    std::vector<StateSetSubgraph> stateSetSubgraphs;
+
+    for (auto& [masks, transformStatePair] : masksTransformStateMap)
     {
         unsigned int maxNumDescriptors = transformStatePair.stateTransformMap.size();
         if (maxNumDescriptors==0)
@@ -863,60 +2097,106 @@ vsg::ref_ptr<vsg::Node> SceneBuilder::createVSG(vsg::Paths& searchPaths)
             DEBUG_OUTPUT<<"  maxNumDescriptors = "<<maxNumDescriptors<<std::endl;
         }
 
-        uint32_t geometrymask = (masks.second | buildOptions->overrideGeomAttributes) & buildOptions->supportedGeometryAttributes;
-        uint32_t shaderModeMask = (masks.first | buildOptions->overrideShaderModeMask) & buildOptions->supportedShaderModeMask;
-        if (shaderModeMask & NORMAL_MAP) geometrymask |= TANGENT; // mesh propably won't have tangets so force them on if we want Normal mapping
+        auto [shaderModeMask, geometrymask] = computeBuildMasks(masks);
 
         DEBUG_OUTPUT<<"  about to call createStateSetWithGraphicsPipeline("<<shaderModeMask<<", "<<geometrymask<<", "<<maxNumDescriptors<<")"<<std::endl;
 
-        auto graphicsPipelineGroup = vsg::StateGroup::create();
-
         auto bindGraphicsPipeline = buildOptions->pipelineCache->getOrCreateBindGraphicsPipeline(shaderModeMask, geometrymask, buildOptions->vertexShaderPath, buildOptions->fragmentShaderPath);
-        graphicsPipelineGroup->add(bindGraphicsPipeline);
-
-        auto graphicsPipeline = bindGraphicsPipeline->getPipeline();
-        auto& descriptorSetLayouts = graphicsPipeline->getPipelineLayout()->getDescriptorSetLayouts();
 
         // attach based on use of transparency
-        if(shaderModeMask & BLEND)
-        {
-            transparentGroup->addChild(graphicsPipelineGroup);
-        }
-        else
+        vsg::ref_ptr<vsg::Group> parent = (shaderModeMask & BLEND) ? transparentGroup : opaqueGroup;
+
+        for (auto& [stateset, transformeGeometryMap] : transformStatePair.stateTransformMap)
         {
-            opaqueGroup->addChild(graphicsPipelineGroup);
+            stateSetSubgraphs.push_back(StateSetSubgraph{parent, bindGraphicsPipeline, shaderModeMask, geometrymask, stateset, &transformeGeometryMap, {}});
         }
+    }
 
-        for (auto[stateset, transformeGeometryMap] : transformStatePair.stateTransformMap)
-        {
-            vsg::ref_ptr<vsg::Node> transformGeometryGraph = createTransformGeometryGraphVSG(transformeGeometryMap, searchPaths, geometrymask);
-            if (!transformGeometryGraph) continue;
+    // the geometries have all been converted so building the subgraphs only reads the shared caches, and can be done in parallel
+    parallelFor(buildOptions->numThreads, stateSetSubgraphs.size(), [&](size_t i)
+    {
+        auto& stateSetSubgraph = stateSetSubgraphs[i];
+        stateSetSubgraph.subgraph = createTransformGeometryGraphVSG(*stateSetSubgraph.transformGeometryMap, searchPaths, stateSetSubgraph.geometryMask);
+    });
 
-            vsg::ref_ptr<vsg::DescriptorSet> descriptorSet = createVsgStateSet(descriptorSetLayouts, stateset, shaderModeMask);
-            if (descriptorSet)
-            {
-                auto stategroup = vsg::StateGroup::create();
-                graphicsPipelineGroup->addChild(stategroup);
-                stategroup->addChild(transformGeometryGraph);
+    for (auto& stateSetSubgraph : stateSetSubgraphs)
+    {
+        vsg::ref_ptr<vsg::Node> transformGeometryGraph = stateSetSubgraph.subgraph;
+        if (!transformGeometryGraph) continue;
 
-                if (buildOptions->useBindDescriptorSet)
-                {
-                    auto bindDescriptorSet = vsg::BindDescriptorSet::create(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->getPipelineLayout(), 0, descriptorSet);
-                    stategroup->add(bindDescriptorSet);
-                }
-                else
-                {
-                    auto bindDescriptorSets = vsg::BindDescriptorSets::create(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->getPipelineLayout(), 0, vsg::DescriptorSets{descriptorSet});
-                    stategroup->add(bindDescriptorSets);
-                }
+        uint32_t shaderModeMask = stateSetSubgraph.shaderModeMask;
+        auto& stateset = stateSetSubgraph.stateset;
+
+        StateSubgraph stateSubgraph;
+
+        if (shaderModeMask & (MATERIAL_STORAGE_BUFFER | BINDLESS_TEXTURES))
+        {
+            // select the stateset's material and texture maps from the storage buffer and bindless texture array
+            auto indicesGroup = vsg::StateGroup::create();
+            if (shaderModeMask & MATERIAL_STORAGE_BUFFER)
+            {
+                auto pushConstants = getOrCreateMaterialIndexPushConstants(stateset);
+                indicesGroup->add(pushConstants);
+                stateSubgraph.pushConstants.push_back(pushConstants.get());
             }
-            else
+            if (shaderModeMask & BINDLESS_TEXTURES)
             {
-                graphicsPipelineGroup->addChild(transformGeometryGraph);
+                auto pushConstants = getOrCreateTextureIndicesPushConstants(stateset, shaderModeMask);
+                indicesGroup->add(pushConstants);
+                stateSubgraph.pushConstants.push_back(pushConstants.get());
             }
+            indicesGroup->addChild(transformGeometryGraph);
+            transformGeometryGraph = indicesGroup;
         }
+
+        auto& descriptorSetLayouts = stateSetSubgraph.bindGraphicsPipeline->getPipeline()->getPipelineLayout()->getDescriptorSetLayouts();
+
+        stateSubgraph.parent = stateSetSubgraph.parent;
+        stateSubgraph.bindGraphicsPipeline = stateSetSubgraph.bindGraphicsPipeline;
+        stateSubgraph.descriptorSet = getOrCreateDescriptorSet(descriptorSetLayouts, stateset, shaderModeMask);
+        stateSubgraph.subgraph = transformGeometryGraph;
+        stateSubgraph.blend = (shaderModeMask & BLEND) != 0;
+
+        for (auto& [matrix, geometries] : *stateSetSubgraph.transformGeometryMap)
+        {
+            stateSubgraph.numDraws += static_cast<uint32_t>(geometries.size());
+            if (buildOptions->frontToBackHint) stateSubgraph.bound.expandBy(boundsCache.computeBound(geometries, matrix));
+        }
+
+        stateSubgraphs.push_back(stateSubgraph);
     }
 
+    // counting the state changes traverses the graph, so is only done when they are to be reported
+    unsortedStateChanges = StateChangeStats();
+    sortedStateChanges = StateChangeStats();
+
+    if (buildOptions->sortStateChanges && buildOptions->reportStateChanges)
+    {
+        // count the unsorted order's state changes on a scratch copy of the graph it would have produced
+        auto unsortedGroup = vsg::Group::create();
+        std::map<const vsg::Group*, vsg::ref_ptr<vsg::Group>> scratchParents;
+        for (auto& parent : {opaqueGroup, transparentGroup})
+        {
+            scratchParents[parent.get()] = vsg::Group::create();
+            unsortedGroup->addChild(scratchParents[parent.get()]);
+        }
+
+        StateSubgraphs unsortedStateSubgraphs(stateSubgraphs);
+        for (auto& stateSubgraph : unsortedStateSubgraphs) stateSubgraph.parent = scratchParents[stateSubgraph.parent.get()];
+        attachStateSubgraphs(unsortedStateSubgraphs);
+
+        unsortedStateChanges = countStateChanges(*unsortedGroup);
+    }
+
+    if (buildOptions->sortStateChanges) sortStateSubgraphs(stateSubgraphs);
+
+    attachStateSubgraphs(stateSubgraphs);
+
+    if (buildOptions->reportStateChanges)
+    {
+        sortedStateChanges = countStateChanges(*group);
+        if (!buildOptions->sortStateChanges) unsortedStateChanges = sortedStateChanges;
+    }
 
     // if we are using CullGroups then place one at the top of the created scene graph
     if (buildOptions->insertCullGroups)
@@ -7,8 +7,27 @@
 
 #include "glsllang/ResourceLimits.h"
 
+#ifdef OSG2VSG_SPIRV_TOOLS
+#include <spirv-tools/optimizer.hpp>
+#endif
+
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
 #include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <thread>
+
+#include <sys/stat.h>
 
 using namespace osg2vsg;
 
@@ -47,6 +66,40 @@ uint32_t osg2vsg::calculateShaderModeMask(const osg::StateSet* stateSet)
     return stateMask;
 }
 
+std::pair<uint32_t, uint32_t> osg2vsg::canonicalizeShaderMasks(uint32_t shaderModeMask, uint32_t geometryAttributes, bool builtInShaders)
+{
+    const uint32_t textureMaps = DIFFUSE_MAP | OPACITY_MAP | AMBIENT_MAP | NORMAL_MAP | SPECULAR_MAP;
+
+    // no shaders or pipelines consume the extra texcoord arrays
+    geometryAttributes &= ~(TEXCOORD1 | TEXCOORD2);
+
+    // same rules as createPSCDefineStrings(..), maps require texcoords and lighting requires normals
+    if ((geometryAttributes & TEXCOORD0) == 0) shaderModeMask &= ~textureMaps;
+    if ((geometryAttributes & NORMAL) == 0) shaderModeMask &= ~LIGHTING;
+    if ((shaderModeMask & MATERIAL) == 0) shaderModeMask &= ~MATERIAL_STORAGE_BUFFER;
+    if ((shaderModeMask & textureMaps) == 0) shaderModeMask &= ~BINDLESS_TEXTURES;
+
+    if (builtInShaders)
+    {
+        // the built in shaders only use normal maps, normals and tangents for lighting, and texcoords for texture maps
+        if ((shaderModeMask & LIGHTING) == 0)
+        {
+            shaderModeMask &= ~NORMAL_MAP;
+            geometryAttributes &= ~NORMAL;
+        }
+        if ((shaderModeMask & NORMAL_MAP) == 0) geometryAttributes &= ~TANGENT;
+        if ((shaderModeMask & textureMaps) == 0) geometryAttributes &= ~TEXCOORD0;
+    }
+
+    // overall bindings only apply to attributes that are present
+    if ((geometryAttributes & NORMAL) == 0) geometryAttributes &= ~NORMAL_OVERALL;
+    if ((geometryAttributes & TANGENT) == 0) geometryAttributes &= ~TANGENT_OVERALL;
+    if ((geometryAttributes & COLOR) == 0) geometryAttributes &= ~COLOR_OVERALL;
+    if ((geometryAttributes & TRANSLATE) == 0) geometryAttributes &= ~TRANSLATE_OVERALL;
+
+    return {shaderModeMask, geometryAttributes};
+}
+
 // create defines string based of shader mask
 
 std::vector<std::string> createPSCDefineStrings(const uint32_t& shaderModeMask, const uint32_t& geometryAttrbutes)
@@ -68,12 +121,14 @@ std::vector<std::string> createPSCDefineStrings(const uint32_t& shaderModeMask,
     if (hasnormal && (shaderModeMask & LIGHTING)) defines.push_back("VSG_LIGHTING");
     
     if(shaderModeMask & MATERIAL) defines.push_back("VSG_MATERIAL");
+    if ((shaderModeMask & MATERIAL) && (shaderModeMask & MATERIAL_STORAGE_BUFFER)) defines.push_back("VSG_MATERIAL_BUFFER");
 
     if (hastex0 && (shaderModeMask & DIFFUSE_MAP)) defines.push_back("VSG_DIFFUSE_MAP");
     if (hastex0 && (shaderModeMask & OPACITY_MAP)) defines.push_back("VSG_OPACITY_MAP");
     if (hastex0 && (shaderModeMask & AMBIENT_MAP)) defines.push_back("VSG_AMBIENT_MAP");
     if (hastex0 && (shaderModeMask & NORMAL_MAP)) defines.push_back("VSG_NORMAL_MAP");
     if (hastex0 && (shaderModeMask & SPECULAR_MAP)) defines.push_back("VSG_SPECULAR_MAP");
+    if (hastex0 && (shaderModeMask & BINDLESS_TEXTURES)) defines.push_back("VSG_BINDLESS_TEXTURES");
 
     if (shaderModeMask & BILLBOARD) defines.push_back("VSG_BILLBOARD");
 
@@ -82,129 +137,218 @@ std::vector<std::string> createPSCDefineStrings(const uint32_t& shaderModeMask,
     return defines;
 }
 
-// insert defines string after the version in source
-
-std::string processGLSLShaderSource(const std::string& source, const std::vector<std::string>& defines)
+namespace
 {
-    // trim leading spaces/tabs
-    auto trimLeading = [](std::string& str)
-    {
-        size_t startpos = str.find_first_not_of(" \t");
-        if (std::string::npos != startpos)
-        {
-            str = str.substr(startpos);
-        }
-    };
-
-    // trim trailing spaces/tabs/newlines
-    auto trimTrailing = [](std::string& str)
+    // trim leading spaces/tabs and trailing spaces/tabs/newlines
+    std::string_view sanitise(std::string_view str)
     {
-        size_t endpos = str.find_last_not_of(" \t\n");
-        if (endpos != std::string::npos)
-        {
-            str = str.substr(0, endpos+1);
-        }
-    };
+        auto startpos = str.find_first_not_of(" \t");
+        if (startpos == std::string_view::npos) return {};
 
-    // sanitise line by triming leading and trailing characters
-    auto sanitise = [&trimLeading, &trimTrailing](std::string& str)
-    {
-        trimLeading(str);
-        trimTrailing(str);
-    };
+        auto endpos = str.find_last_not_of(" \t\r\n");
+        return str.substr(startpos, endpos - startpos + 1);
+    }
 
     // return true if str starts with match string
-    auto startsWith = [](const std::string& str, const std::string& match)
+    bool startsWith(std::string_view str, std::string_view match)
     {
-        return str.compare(0, match.length(), match) == 0;
-    };
+        return str.substr(0, match.length()) == match;
+    }
 
     // returns the string between the start and end character
-    auto stringBetween = [](const std::string& str, const char& startChar, const char& endChar)
+    std::string_view stringBetween(std::string_view str, char startChar, char endChar)
     {
-        auto start = str.find_first_of(startChar);
-        if (start == std::string::npos) return std::string();
-
-        auto end = str.find_first_of(endChar, start);
-        if (end == std::string::npos) return std::string();
+        auto start = str.find(startChar);
+        if (start == std::string_view::npos) return {};
 
-        if((end - start) - 1 == 0) return std::string();
+        auto end = str.find(endChar, start + 1);
+        if (end == std::string_view::npos) return {};
 
-        return str.substr(start+1, (end - start) - 1);
-    };
+        return str.substr(start + 1, end - start - 1);
+    }
 
-    auto split = [](const std::string& str, const char& seperator)
+    bool getFileStamp(const vsg::Path& path, int64_t& modificationTime, int64_t& size)
     {
-        std::vector<std::string> elements;
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) return false;
 
-        std::string::size_type prev_pos = 0, pos = 0;
+        modificationTime = static_cast<int64_t>(info.st_mtime);
+        size = static_cast<int64_t>(info.st_size);
+        return true;
+    }
 
-        while ((pos = str.find(seperator, pos)) != std::string::npos)
+    vsg::Path findShaderFile(const vsg::Path& filename, const vsg::Path& directory, const vsg::Paths& searchPaths)
+    {
+        if (!directory.empty())
         {
-            auto substring = str.substr(prev_pos, pos - prev_pos);
-            elements.push_back(substring);
-            prev_pos = ++pos;
+            auto path = vsg::concatPaths(directory, filename);
+            if (vsg::fileExists(path)) return path;
         }
 
-        elements.push_back(str.substr(prev_pos, pos - prev_pos));
+        if (vsg::fileExists(filename)) return filename;
 
-        return elements;
-    };
+        for (auto& searchPath : searchPaths)
+        {
+            auto path = vsg::concatPaths(searchPath, filename);
+            if (vsg::fileExists(path)) return path;
+        }
 
-    auto addLine = [](std::ostringstream& ss, const std::string& line)
-    {
-        ss << line << "\n";
-    };
+        return {};
+    }
 
-    std::istringstream iss(source);
-    std::ostringstream headerstream;
-    std::ostringstream sourcestream;
+    // guard against #include cycles
+    const uint32_t maxIncludeDepth = 32;
+}
 
-    const std::string versionmatch = "#version";
-    const std::string importdefinesmatch = "#pragma import_defines";
+ShaderTemplate::ShaderTemplate(const std::string& source, const vsg::Path& directory, const vsg::Paths& searchPaths)
+{
+    _body.reserve(source.size());
+    parse(source, directory, searchPaths, 0);
 
-    std::vector<std::string> finaldefines;
+    for (auto& headerLine : _header)
+    {
+        _headerSize += headerLine.text.size();
+        for (auto& importedDefine : headerLine.importedDefines) _headerSize += importedDefine.size() + 9;
+    }
+}
 
-    for (std::string line; std::getline(iss, line);)
+void ShaderTemplate::parse(const std::string& source, const vsg::Path& directory, const vsg::Paths& searchPaths, uint32_t depth)
+{
+    const std::string_view versionmatch = "#version";
+    const std::string_view importdefinesmatch = "#pragma import_defines";
+    const std::string_view includematch = "#include";
+
+    std::string_view remaining(source);
+    while (!remaining.empty())
     {
-        std::string sanitisedline = line;
-        sanitise(sanitisedline);
+        auto endofline = remaining.find('\n');
+        auto line = remaining.substr(0, endofline);
+        remaining = (endofline == std::string_view::npos) ? std::string_view() : remaining.substr(endofline + 1);
+
+        auto sanitisedline = sanitise(line);
 
         // is it the version
-        if(startsWith(sanitisedline, versionmatch))
+        if (startsWith(sanitisedline, versionmatch))
         {
-            addLine(headerstream, line);
+            _header.push_back(HeaderLine{std::string(line) + "\n", {}});
         }
         // is it the defines import
         else if (startsWith(sanitisedline, importdefinesmatch))
         {
-            // get the import defines between ()
-            auto csv = stringBetween(sanitisedline, '(', ')');
-            auto importedDefines = split(csv, ',');
-
-            addLine(headerstream, line);
+            HeaderLine headerLine{std::string(line) + "\n", {}};
 
-            // loop the imported defines and see if it's also requested in defines, if so insert a define line
-            for (auto importedDef : importedDefines)
+            // get the comma separated import defines between ()
+            auto csv = stringBetween(sanitisedline, '(', ')');
+            if (!csv.empty())
             {
-                auto sanitiesedImportDef = importedDef;
-                sanitise(sanitiesedImportDef);
-
-                auto finditr = std::find(defines.begin(), defines.end(), sanitiesedImportDef);
-                if (finditr != defines.end())
+                for (size_t pos = 0; pos != std::string_view::npos;)
                 {
-                    addLine(headerstream, "#define " + sanitiesedImportDef);
+                    auto seperator = csv.find(',', pos);
+                    auto importedDefine = sanitise(csv.substr(pos, seperator == std::string_view::npos ? seperator : seperator - pos));
+                    headerLine.importedDefines.emplace_back(importedDefine);
+                    pos = (seperator == std::string_view::npos) ? seperator : seperator + 1;
                 }
             }
+
+            _header.push_back(std::move(headerLine));
+        }
+        // expand includes in place
+        else if (startsWith(sanitisedline, includematch))
+        {
+            auto filename = stringBetween(sanitisedline, '"', '"');
+            if (filename.empty()) filename = stringBetween(sanitisedline, '<', '>');
+
+            vsg::Path path = filename.empty() ? vsg::Path() : findShaderFile(vsg::Path(filename), directory, searchPaths);
+
+            std::string includeSource;
+            FileStamp stamp{path, 0, 0};
+            if (!path.empty() && depth < maxIncludeDepth && getFileStamp(path, stamp.modificationTime, stamp.size) && vsg::readFile(includeSource, path))
+            {
+                _dependencies.push_back(stamp);
+                parse(includeSource, osgDB::getFilePath(path), searchPaths, depth + 1);
+            }
+            else
+            {
+                // leave the line for the shader compiler to report
+                DEBUG_OUTPUT << "ShaderTemplate: Failed to resolve " << sanitisedline << std::endl;
+                _body.append(line);
+                _body.push_back('\n');
+            }
         }
         else
         {
             // standard source line
-            addLine(sourcestream, line);
+            _body.append(line);
+            _body.push_back('\n');
         }
     }
+}
+
+bool ShaderTemplate::upToDate() const
+{
+    for (auto& dependency : _dependencies)
+    {
+        int64_t modificationTime = 0, size = 0;
+        if (!getFileStamp(dependency.path, modificationTime, size) || modificationTime != dependency.modificationTime || size != dependency.size) return false;
+    }
+    return true;
+}
+
+std::string ShaderTemplate::createSource(const std::vector<std::string>& defines) const
+{
+    std::string source;
+    source.reserve(_headerSize + _body.size());
+
+    for (auto& headerLine : _header)
+    {
+        source.append(headerLine.text);
+
+        // insert a define line for each imported define that is also requested in defines
+        for (auto& importedDefine : headerLine.importedDefines)
+        {
+            if (std::find(defines.begin(), defines.end(), importedDefine) != defines.end())
+            {
+                source.append("#define ");
+                source.append(importedDefine);
+                source.push_back('\n');
+            }
+        }
+    }
+
+    source.append(_body);
+    return source;
+}
+
+std::string ShaderTemplate::createSource(const uint32_t& shaderModeMask, const uint32_t& geometryAttrbutes) const
+{
+    return createSource(createPSCDefineStrings(shaderModeMask, geometryAttrbutes));
+}
+
+vsg::ref_ptr<ShaderTemplate> ShaderTemplate::read(const vsg::Path& filename, const vsg::Paths& searchPaths)
+{
+    static std::mutex s_mutex;
+    static std::map<vsg::Path, vsg::ref_ptr<ShaderTemplate>> s_templates;
+
+    auto path = findShaderFile(filename, {}, searchPaths);
+    if (path.empty()) return {};
+
+    {
+        std::lock_guard<std::mutex> guard(s_mutex);
+        auto itr = s_templates.find(path);
+        if (itr != s_templates.end() && itr->second->upToDate()) return itr->second;
+    }
+
+    // stamp the file before reading it so a modification while reading causes a reparse next time
+    FileStamp stamp{path, 0, 0};
+    std::string source;
+    if (!getFileStamp(path, stamp.modificationTime, stamp.size) || !vsg::readFile(source, path)) return {};
 
-    return headerstream.str() + sourcestream.str();
+    auto shaderTemplate = ShaderTemplate::create(source, osgDB::getFilePath(path), searchPaths);
+    shaderTemplate->_dependencies.insert(shaderTemplate->_dependencies.begin(), stamp);
+
+    std::lock_guard<std::mutex> guard(s_mutex);
+    s_templates[path] = shaderTemplate;
+    return shaderTemplate;
 }
 
 std::string debugFormatShaderSource(const std::string& source)
@@ -225,27 +369,25 @@ std::string debugFormatShaderSource(const std::string& source)
 // read a glsl file and inject defines based on shadermodemask and geometryatts
 std::string osg2vsg::readGLSLShader(const std::string& filename, const uint32_t& shaderModeMask, const uint32_t& geometryAttrbutes)
 {
-    std::string sourceBuffer;
-    if (!vsg::readFile(sourceBuffer, filename))
+    static const vsg::Paths s_searchPaths = vsg::getEnvPaths("VSG_FILE_PATH");
+
+    auto shaderTemplate = ShaderTemplate::read(filename, s_searchPaths);
+    if (!shaderTemplate)
     {
         DEBUG_OUTPUT << "readGLSLShader: Failed to read file '" << filename << std::endl;
         return std::string();
     }
 
-    auto defines = createPSCDefineStrings(shaderModeMask, geometryAttrbutes);
-    std::string formatedSource = processGLSLShaderSource(sourceBuffer, defines);
-    return formatedSource;
+    return shaderTemplate->createSource(shaderModeMask, geometryAttrbutes);
 }
 
-// create an fbx vertex shader
+// create an fbx vertex shader, the built in shader sources are parsed once on first use
 #include "shaders/fbxshader_vert.cpp"
 
 std::string osg2vsg::createFbxVertexSource(const uint32_t& shaderModeMask, const uint32_t& geometryAttrbutes)
 {
-    auto defines = createPSCDefineStrings(shaderModeMask, geometryAttrbutes);
-    std::string formatedSource = processGLSLShaderSource(fbxshader_vert, defines);
-
-    return formatedSource;
+    static auto s_template = ShaderTemplate::create(fbxshader_vert);
+    return s_template->createSource(shaderModeMask, geometryAttrbutes);
 }
 
 // create an fbx fragment shader
@@ -253,10 +395,8 @@ std::string osg2vsg::createFbxVertexSource(const uint32_t& shaderModeMask, const
 
 std::string osg2vsg::createFbxFragmentSource(const uint32_t& shaderModeMask, const uint32_t& geometryAttrbutes)
 {
-    auto defines = createPSCDefineStrings(shaderModeMask, geometryAttrbutes);
-    std::string formatedSource = processGLSLShaderSource(fbxshader_frag, defines);
-
-    return formatedSource;
+    static auto s_template = ShaderTemplate::create(fbxshader_frag);
+    return s_template->createSource(shaderModeMask, geometryAttrbutes);
 }
 
 // create a default vertex shader
@@ -264,10 +404,8 @@ std::string osg2vsg::createFbxFragmentSource(const uint32_t& shaderModeMask, con
 
 std::string osg2vsg::createDefaultVertexSource(const uint32_t& shaderModeMask, const uint32_t& geometryAttrbutes)
 {
-    auto defines = createPSCDefineStrings(shaderModeMask, geometryAttrbutes);
-    std::string formatedSource = processGLSLShaderSource(defaultshader_vert, defines);
-
-    return formatedSource;
+    static auto s_template = ShaderTemplate::create(defaultshader_vert);
+    return s_template->createSource(shaderModeMask, geometryAttrbutes);
 }
 
 // create a default fragment shader
@@ -275,16 +413,215 @@ std::string osg2vsg::createDefaultVertexSource(const uint32_t& shaderModeMask, c
 
 std::string osg2vsg::createDefaultFragmentSource(const uint32_t& shaderModeMask, const uint32_t& geometryAttrbutes)
 {
-    auto defines = createPSCDefineStrings(shaderModeMask, geometryAttrbutes);
-    std::string formatedSource = processGLSLShaderSource(defaultshader_frag, defines);
+    static auto s_template = ShaderTemplate::create(defaultshader_frag);
+    return s_template->createSource(shaderModeMask, geometryAttrbutes);
+}
+
+// create an fbx uber vertex shader
+#include "shaders/fbxshader_uber_vert.cpp"
+
+std::string osg2vsg::createFbxUberVertexSource(const uint32_t& geometryAttrbutes)
+{
+    static auto s_template = ShaderTemplate::create(fbxshader_uber_vert);
+    // the uber shaders only import the geometry defines so the shader mode defines are ignored
+    return s_template->createSource(NONE, geometryAttrbutes);
+}
+
+// create an fbx uber fragment shader
+#include "shaders/fbxshader_uber_frag.cpp"
+
+std::string osg2vsg::createFbxUberFragmentSource(const uint32_t& geometryAttrbutes)
+{
+    static auto s_template = ShaderTemplate::create(fbxshader_uber_frag);
+    return s_template->createSource(NONE, geometryAttrbutes);
+}
+
+std::vector<VkSpecializationMapEntry> osg2vsg::createUberShaderSpecializationMapEntries()
+{
+    // each constant is a VkBool32 stored at its id in the specialization data
+    std::vector<VkSpecializationMapEntry> entries;
+    for(uint32_t id = 0; id < NUM_UBER_SHADER_CONSTANTS; ++id)
+    {
+        entries.push_back(VkSpecializationMapEntry{id, static_cast<uint32_t>(id * sizeof(VkBool32)), sizeof(VkBool32)});
+    }
+    return entries;
+}
+
+vsg::ref_ptr<vsg::uintArray> osg2vsg::createUberShaderSpecializationData(const uint32_t& shaderModeMask, const uint32_t& geometryAttrbutes)
+{
+    // apply the same rules as createPSCDefineStrings(..) so the uber shaders match the #define permutations
+    bool hasnormal = geometryAttrbutes & NORMAL;
+    bool hastex0 = geometryAttrbutes & TEXCOORD0;
+
+    auto data = vsg::uintArray::create(NUM_UBER_SHADER_CONSTANTS);
+    data->at(LIGHTING_CONSTANT) = (hasnormal && (shaderModeMask & LIGHTING)) ? VK_TRUE : VK_FALSE;
+    data->at(MATERIAL_CONSTANT) = (shaderModeMask & MATERIAL) ? VK_TRUE : VK_FALSE;
+    data->at(DIFFUSE_MAP_CONSTANT) = (hastex0 && (shaderModeMask & DIFFUSE_MAP)) ? VK_TRUE : VK_FALSE;
+    data->at(OPACITY_MAP_CONSTANT) = (hastex0 && (shaderModeMask & OPACITY_MAP)) ? VK_TRUE : VK_FALSE;
+    data->at(AMBIENT_MAP_CONSTANT) = (hastex0 && (shaderModeMask & AMBIENT_MAP)) ? VK_TRUE : VK_FALSE;
+    data->at(NORMAL_MAP_CONSTANT) = (hastex0 && (shaderModeMask & NORMAL_MAP)) ? VK_TRUE : VK_FALSE;
+    data->at(SPECULAR_MAP_CONSTANT) = (hastex0 && (shaderModeMask & SPECULAR_MAP)) ? VK_TRUE : VK_FALSE;
+    data->at(BILLBOARD_CONSTANT) = (shaderModeMask & BILLBOARD) ? VK_TRUE : VK_FALSE;
+    return data;
+}
+
+///////////////////////////////////////////////////////////////////////////////////
+//
+// Precompiled SPIR-V
+//
+uint64_t osg2vsg::hashShaderSource(VkShaderStageFlagBits stage, const std::string& source)
+{
+    // 64bit FNV-1a, must be stable across builds as the precompile_shaders tool bakes the values into the library
+    uint64_t hash = 14695981039346656037ull;
+    auto accumulate = [&hash](uint8_t byte)
+    {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    };
+
+    for(int i=0; i<4; ++i) accumulate(static_cast<uint8_t>((static_cast<uint32_t>(stage) >> (i*8)) & 0xff));
+    for(auto c : source) accumulate(static_cast<uint8_t>(c));
+
+    return hash;
+}
+
+#ifdef OSG2VSG_PRECOMPILED_SHADERS
+#include "PrecompiledShaders.h"
+
+bool osg2vsg::getPrecompiledSPIRV(VkShaderStageFlagBits stage, const std::string& source, vsg::ShaderModule::SPIRV& spirv)
+{
+    using namespace osg2vsg::precompiled;
+
+    auto key = hashShaderSource(stage, source);
+
+    // entries are sorted by key by the precompile_shaders tool
+    auto itr = std::lower_bound(entries, entries + numEntries, key, [](const Entry& entry, uint64_t value) { return entry.key < value; });
+    if (itr == entries + numEntries || itr->key != key) return false;
+
+    spirv.assign(words + itr->offset, words + itr->offset + itr->size);
+    return true;
+}
+#else
+bool osg2vsg::getPrecompiledSPIRV(VkShaderStageFlagBits /*stage*/, const std::string& /*source*/, vsg::ShaderModule::SPIRV& /*spirv*/)
+{
+    return false;
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+//
+// ShaderCache
+//
+ShaderCache::ShaderCache(const vsg::Path& in_directory) :
+    directory(in_directory)
+{
+}
+
+std::string ShaderCache::computeKey(VkShaderStageFlagBits stage, const std::string& source, const std::string& settings)
+{
+    // 128bit FNV-1a, held as two 64bit words as there is no portable 128bit integer
+    uint64_t hi = 0x6c62272e07bb0142ull;
+    uint64_t lo = 0x62b821756295c58dull;
+
+    auto hash = [&hi, &lo](const void* ptr, size_t size)
+    {
+        auto bytes = reinterpret_cast<const uint8_t*>(ptr);
+        for(size_t i=0; i<size; ++i)
+        {
+            lo ^= bytes[i];
+
+            // multiply by the FNV prime 2^88 + 0x13b, splitting lo into 32bit halves to carry into hi
+            uint64_t p0 = (lo & 0xffffffffull) * 0x13bull;
+            uint64_t p1 = (lo >> 32) * 0x13bull;
+            uint64_t mid = (p0 >> 32) + (p1 & 0xffffffffull);
+            uint64_t carry = (p1 >> 32) + (mid >> 32);
+
+            hi = hi * 0x13bull + carry + (lo << 24);
+            lo = (mid << 32) | (p0 & 0xffffffffull);
+        }
+    };
+
+    hash(settings.data(), settings.size());
+    hash(&stage, sizeof(stage));
+    hash(source.data(), source.size());
+
+    std::ostringstream key;
+    key << std::hex << std::setfill('0') << std::setw(16) << hi << std::setw(16) << lo;
+    return key.str();
+}
+
+bool ShaderCache::read(const std::string& key, vsg::ShaderModule::SPIRV& spirv) const
+{
+    std::ifstream fin(vsg::concatPaths(directory, key + ".spv"), std::ios::in | std::ios::binary | std::ios::ate);
+    if (!fin) return false;
+
+    // SPIR-V is a stream of 32bit words
+    auto size = static_cast<size_t>(fin.tellg());
+    if (size==0 || (size % sizeof(uint32_t))!=0) return false;
+
+    vsg::ShaderModule::SPIRV words(size / sizeof(uint32_t));
+    fin.seekg(0);
+    fin.read(reinterpret_cast<char*>(words.data()), size);
+    if (!fin) return false;
+
+    // check the SPIR-V magic number to catch corrupt entries
+    if (words[0] != 0x07230203) return false;
+
+    spirv.swap(words);
+    return true;
+}
+
+bool ShaderCache::write(const std::string& key, const vsg::ShaderModule::SPIRV& spirv) const
+{
+    if (spirv.empty()) return false;
+
+    if (!vsg::fileExists(directory) && !osgDB::makeDirectory(directory))
+    {
+        DEBUG_OUTPUT << "ShaderCache::write() could not create directory " << directory << std::endl;
+        return false;
+    }
+
+    // write to a uniquely named temporary file first so that concurrent readers and writers, in this or other processes, only ever see complete entries
+    static std::atomic_uint s_tempCount{0};
+    auto filename = vsg::concatPaths(directory, key + ".spv");
+    auto tempFilename = vsg::make_string(filename, ".", std::hash<std::thread::id>()(std::this_thread::get_id()), ".", std::chrono::steady_clock::now().time_since_epoch().count(), ".", s_tempCount++);
+
+    {
+        std::ofstream fout(tempFilename, std::ios::out | std::ios::binary);
+        if (!fout) return false;
+
+        fout.write(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+        if (!fout)
+        {
+            fout.close();
+            std::remove(tempFilename.c_str());
+            return false;
+        }
+    }
 
-    return formatedSource;
+    if (std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+    {
+        // another writer may have got there first, which is fine as the contents will be the same
+        std::remove(tempFilename.c_str());
+        return vsg::fileExists(filename);
+    }
+
+    return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////////
+//
+// ShaderCompiler
+//
 ShaderCompiler::ShaderCompiler(vsg::Allocator* allocator):
     Inherit(allocator)
 {
     glslang::InitializeProcess();
+
+    if (const char* cacheDirectory = std::getenv("OSG2VSG_SHADER_CACHE"); cacheDirectory && *cacheDirectory)
+    {
+        shaderCache = ShaderCache::create(cacheDirectory);
+    }
 }
 
 ShaderCompiler::~ShaderCompiler()
@@ -292,6 +629,70 @@ ShaderCompiler::~ShaderCompiler()
     glslang::FinalizeProcess();
 }
 
+std::string ShaderCompiler::settings() const
+{
+    // must be kept in sync with the settings used in compile(..)
+    // include the tool versions so an upgraded toolchain doesn't read SPIR-V cached by the old one
+    std::string compileSettings = vsg::make_string("glslang ", glslang::GetGlslVersionString(), " input=GLSL-150 client=Vulkan-1.1 target=SPIR-V-1.0 defaultVersion=110 messages=default");
+
+    if (optimizeOptions.changesSPIRV())
+    {
+        compileSettings += vsg::make_string(" preset=", optimizeOptions.preset, " dce=", optimizeOptions.deadCodeElimination, " fold=", optimizeOptions.constantFolding, " strip=", optimizeOptions.stripDebugInfo);
+#ifdef OSG2VSG_SPIRV_TOOLS
+        compileSettings += vsg::make_string(" SPIRV-Tools ", spvSoftwareVersionString());
+#endif
+    }
+
+    return compileSettings;
+}
+
+bool ShaderCompiler::optimize(VkShaderStageFlagBits stage, vsg::ShaderModule::SPIRV& spirv)
+{
+    if (!optimizeOptions.deadCodeElimination && !optimizeOptions.constantFolding) return true;
+
+#ifdef OSG2VSG_SPIRV_TOOLS
+    spvtools::Optimizer optimizer(SPV_ENV_VULKAN_1_1);
+    optimizer.SetMessageConsumer([](spv_message_level_t level, const char*, const spv_position_t&, const char* message)
+    {
+        if (level <= SPV_MSG_ERROR) INFO_OUTPUT << "SPIRV-Tools: " << message << std::endl;
+    });
+
+    if (optimizeOptions.constantFolding)
+    {
+        optimizer.RegisterPass(spvtools::CreateFoldSpecConstantOpAndCompositePass());
+        optimizer.RegisterPass(spvtools::CreateCCPPass());
+    }
+
+    if (optimizeOptions.deadCodeElimination)
+    {
+        optimizer.RegisterPass(spvtools::CreateDeadBranchElimPass());
+        optimizer.RegisterPass(spvtools::CreateAggressiveDCEPass());
+        optimizer.RegisterPass(spvtools::CreateEliminateDeadFunctionsPass());
+        optimizer.RegisterPass(spvtools::CreateEliminateDeadConstantPass());
+    }
+
+    vsg::ShaderModule::SPIRV optimized;
+    if (!optimizer.Run(spirv.data(), spirv.size(), &optimized))
+    {
+        INFO_OUTPUT << "Warning: SPIRV-Tools optimization of " << stage << " shader failed, using unoptimized SPIR-V." << std::endl;
+        return false;
+    }
+
+    spirv.swap(optimized);
+    return true;
+#else
+    static bool s_warned = false;
+    if (!s_warned)
+    {
+        INFO_OUTPUT << "Warning: osg2vsg built without SPIRV-Tools-opt, dead code elimination and constant folding passes unavailable, use the PERFORMANCE or SIZE presets." << std::endl;
+        s_warned = true;
+    }
+    (void)stage;
+    (void)spirv;
+    return false;
+#endif
+}
+
 bool ShaderCompiler::compile(vsg::ShaderStages& shaders)
 {
     auto getFriendlyNameForShader = [](const vsg::ref_ptr<vsg::ShaderStage>& vsg_shader)
@@ -309,6 +710,34 @@ bool ShaderCompiler::compile(vsg::ShaderStages& shaders)
         return "";
     };
 
+    ScopedTiming timing(instrumentation.get(), "glslang compile");
+
+    // see if all the shader stages can be satisfied from the shader cache
+    std::vector<std::string> cacheKeys;
+    if (shaderCache)
+    {
+        auto compileSettings = settings();
+        std::vector<vsg::ShaderModule::SPIRV> cachedSpirv(shaders.size());
+        size_t numFound = 0;
+        for(size_t i=0; i<shaders.size(); ++i)
+        {
+            auto& vsg_shader = shaders[i];
+            cacheKeys.push_back(ShaderCache::computeKey(vsg_shader->getShaderStageFlagBits(), vsg_shader->getShaderModule()->source(), compileSettings));
+            if (shaderCache->read(cacheKeys.back(), cachedSpirv[i])) ++numFound;
+        }
+
+        // cached SPIR-V isn't validated or measured, so only use it when neither is requested
+        if (numFound==shaders.size() && !optimizeOptions.validate && !optimizeOptions.reportSizes)
+        {
+            for(size_t i=0; i<shaders.size(); ++i)
+            {
+                shaders[i]->getShaderModule()->spirv().swap(cachedSpirv[i]);
+            }
+            count(instrumentation.get(), "shader cache hits", static_cast<int64_t>(shaders.size()));
+            return true;
+        }
+    }
+
     using StageShaderMap = std::map<EShLanguage, vsg::ref_ptr<vsg::ShaderStage>>;
     using TShaders = std::list<std::unique_ptr<glslang::TShader>>;
     TShaders tshaders;
@@ -411,9 +840,39 @@ bool ShaderCompiler::compile(vsg::ShaderStages& shaders)
             std::string warningsErrors;
             spv::SpvBuildLogger logger;
             glslang::SpvOptions spvOptions;
+            spvOptions.disableOptimizer = (optimizeOptions.preset == ShaderOptimizeOptions::NO_PRESET);
+            spvOptions.optimizeSize = (optimizeOptions.preset == ShaderOptimizeOptions::SIZE);
+            spvOptions.stripDebugInfo = optimizeOptions.stripDebugInfo;
+            spvOptions.validate = optimizeOptions.validate;
             glslang::GlslangToSpv(*(program->getIntermediate((EShLanguage)eshl_stage)), vsg_shader->getShaderModule()->spirv(), &logger, &spvOptions);
+
+            auto messages = logger.getAllMessages();
+            if (!messages.empty()) INFO_OUTPUT << getFriendlyNameForShader(vsg_shader) << " SPIR-V generation messages:" << std::endl << messages;
+
+            auto& shaderSPIRV = vsg_shader->getShaderModule()->spirv();
+            size_t generatedSize = shaderSPIRV.size() * sizeof(uint32_t);
+
+            optimize(vsg_shader->getShaderStageFlagBits(), shaderSPIRV);
+
+            if (optimizeOptions.reportSizes)
+            {
+                size_t finalSize = shaderSPIRV.size() * sizeof(uint32_t);
+                INFO_OUTPUT << getFriendlyNameForShader(vsg_shader) << " " << std::hex << hashShaderSource(vsg_shader->getShaderStageFlagBits(), vsg_shader->getShaderModule()->source()) << std::dec << " SPIR-V size " << finalSize << " bytes";
+                if (finalSize != generatedSize) INFO_OUTPUT << " (" << generatedSize << " bytes before SPIRV-Tools passes)";
+                INFO_OUTPUT << std::endl;
+            }
+        }
+    }
+
+    // store the newly compiled SPIR-V so that subsequent runs can skip glslang
+    if (shaderCache)
+    {
+        for(size_t i=0; i<shaders.size(); ++i)
+        {
+            shaderCache->write(cacheKeys[i], shaders[i]->getShaderModule()->spirv());
         }
     }
 
+    count(instrumentation.get(), "shaders compiled", static_cast<int64_t>(shaders.size()));
     return true;
 }
@@ -0,0 +1,222 @@
+#include <osg2vsg/SpatialHierarchy.h>
+
+#include <vsg/nodes/CullGroup.h>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+using namespace osg2vsg;
+
+namespace
+{
+    struct Bounds
+    {
+        vsg::vec3 min = vsg::vec3(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+        vsg::vec3 max = vsg::vec3(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+
+        bool valid() const { return min.x <= max.x; }
+
+        void expandBy(const vsg::vec3& v)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                min[i] = std::min(min[i], v[i]);
+                max[i] = std::max(max[i], v[i]);
+            }
+        }
+
+        void expandBy(const vsg::sphere& s)
+        {
+            vsg::vec3 r(s.radius, s.radius, s.radius);
+            expandBy(s.center - r);
+            expandBy(s.center + r);
+        }
+
+        float area() const
+        {
+            if (!valid()) return 0.0f;
+            vsg::vec3 d = max - min;
+            return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+        }
+
+        int longestAxis() const
+        {
+            vsg::vec3 d = max - min;
+            if (d.x >= d.y && d.x >= d.z) return 0;
+            return (d.y >= d.z) ? 1 : 2;
+        }
+
+        vsg::sphere sphere() const { return vsg::sphere((min + max) * 0.5f, vsg::length(max - min) * 0.5f); }
+    };
+
+    using Indices = std::vector<size_t>;
+    using Iterator = Indices::iterator;
+
+    struct HierarchyBuilder
+    {
+        const BoundedNodes& nodes;
+        uint32_t leafSize;
+        SplitMethod splitMethod;
+
+        // order by centre along the axis, ties broken by the original order so the hierarchy is deterministic
+        auto lessAlong(int axis) const
+        {
+            return [this, axis](size_t lhs, size_t rhs) {
+                float l = nodes[lhs].bound.center[axis];
+                float r = nodes[rhs].bound.center[axis];
+                return (l < r) || (l == r && lhs < rhs);
+            };
+        }
+
+        Iterator splitMedian(Iterator begin, Iterator end) const
+        {
+            Bounds centres;
+            for (auto itr = begin; itr != end; ++itr) centres.expandBy(nodes[*itr].bound.center);
+
+            auto middle = begin + (end - begin) / 2;
+            std::nth_element(begin, middle, end, lessAlong(centres.longestAxis()));
+            return middle;
+        }
+
+        Iterator splitSAH(Iterator begin, Iterator end) const
+        {
+            size_t count = end - begin;
+            size_t half = count / 2;
+
+            float bestCost = std::numeric_limits<float>::max();
+            int bestAxis = 0;
+            size_t bestSplit = half;
+
+            Indices sorted(begin, end);
+            std::vector<float> rightAreas(count);
+
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                std::sort(sorted.begin(), sorted.end(), lessAlong(axis));
+
+                Bounds right;
+                for (size_t i = count - 1; i > 0; --i)
+                {
+                    right.expandBy(nodes[sorted[i]].bound);
+                    rightAreas[i] = right.area();
+                }
+
+                // cost of splitting before i, on equal cost prefer the more balanced split so degenerate bounds still halve
+                Bounds left;
+                for (size_t i = 1; i < count; ++i)
+                {
+                    left.expandBy(nodes[sorted[i - 1]].bound);
+                    float cost = left.area() * static_cast<float>(i) + rightAreas[i] * static_cast<float>(count - i);
+                    auto distance = [half](size_t split) { return split > half ? split - half : half - split; };
+                    if (cost < bestCost || (cost == bestCost && distance(i) < distance(bestSplit)))
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = i;
+                    }
+                }
+            }
+
+            std::sort(begin, end, lessAlong(bestAxis));
+            return begin + bestSplit;
+        }
+
+        vsg::ref_ptr<vsg::Node> build(Iterator begin, Iterator end) const
+        {
+            Bounds bounds;
+            for (auto itr = begin; itr != end; ++itr) bounds.expandBy(nodes[*itr].bound);
+
+            auto cullGroup = vsg::CullGroup::create(bounds.sphere());
+
+            if (static_cast<size_t>(end - begin) <= leafSize)
+            {
+                // keep the original order of the nodes within a leaf
+                std::sort(begin, end);
+                for (auto itr = begin; itr != end; ++itr) cullGroup->addChild(nodes[*itr].node);
+                return cullGroup;
+            }
+
+            auto middle = (splitMethod == SplitMethod::SAH) ? splitSAH(begin, end) : splitMedian(begin, end);
+
+            // place the half containing the earliest node first
+            bool leftFirst = *std::min_element(begin, middle) < *std::min_element(middle, end);
+            auto first = leftFirst ? build(begin, middle) : build(middle, end);
+            auto second = leftFirst ? build(middle, end) : build(begin, middle);
+
+            cullGroup->addChild(first);
+            cullGroup->addChild(second);
+            return cullGroup;
+        }
+    };
+}
+
+vsg::ref_ptr<vsg::Node> osg2vsg::createSpatialHierarchy(const BoundedNodes& nodes, uint32_t leafSize, SplitMethod splitMethod)
+{
+    if (nodes.empty()) return {};
+
+    Indices indices(nodes.size());
+    for (size_t i = 0; i < indices.size(); ++i) indices[i] = i;
+
+    HierarchyBuilder builder{nodes, std::max(leafSize, 1u), splitMethod};
+    return builder.build(indices.begin(), indices.end());
+}
+
+float CullCostModel::cullProbability(float radius, float parentRadius, uint32_t numOverlappingSiblings) const
+{
+    if (parentRadius <= 0.0f || radius >= parentRadius) return 0.0f;
+
+    return (1.0f - radius / parentRadius) / static_cast<float>(1 + numOverlappingSiblings);
+}
+
+float CullCostModel::expectedDrawSavings(uint32_t numTriangles, float radius, float parentRadius, uint32_t numOverlappingSiblings) const
+{
+    return cullProbability(radius, parentRadius, numOverlappingSiblings) * (drawCost + triangleCost * static_cast<float>(numTriangles));
+}
+
+void CullCostStats::add(const CullCostStats& rhs)
+{
+    numCandidates += rhs.numCandidates;
+    numCullNodes += rhs.numCullNodes;
+    expectedCullCost += rhs.expectedCullCost;
+    expectedDrawSavings += rhs.expectedDrawSavings;
+}
+
+void CullCostStats::print(std::ostream& out) const
+{
+    out << "Cull nodes " << numCullNodes << " of " << numCandidates << " candidates, expected cost per frame " << expectedCullCost
+        << " for draw savings of " << expectedDrawSavings << " (triangle units)" << std::endl;
+}
+
+std::vector<uint32_t> osg2vsg::countOverlaps(const std::vector<vsg::sphere>& spheres, uint32_t maxCount)
+{
+    std::vector<uint32_t> counts(spheres.size(), 0);
+
+    // sweep along x so only the spheres whose x extents overlap are tested
+    Indices order(spheres.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+        return (spheres[lhs].center.x - spheres[lhs].radius) < (spheres[rhs].center.x - spheres[rhs].radius);
+    });
+
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        auto& a = spheres[order[i]];
+        float maxX = a.center.x + a.radius;
+        // each pair is only visited here, so keep sweeping once i is capped as the later spheres may not be
+        for (size_t j = i + 1; j < order.size(); ++j)
+        {
+            auto& b = spheres[order[j]];
+            if ((b.center.x - b.radius) > maxX) break;
+
+            if (counts[order[i]] >= maxCount && counts[order[j]] >= maxCount) continue;
+
+            if (vsg::length(a.center - b.center) < (a.radius + b.radius))
+            {
+                if (counts[order[i]] < maxCount) ++counts[order[i]];
+                if (counts[order[j]] < maxCount) ++counts[order[j]];
+            }
+        }
+    }
+    return counts;
+}
@@ -0,0 +1,147 @@
+#include <osg2vsg/StateSetUtils.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+
+using namespace osg2vsg;
+
+namespace
+{
+    inline void hashCombine(uint64_t& hash, uint64_t value)
+    {
+        hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    }
+
+    inline uint64_t hashString(const std::string& str)
+    {
+        return std::hash<std::string>()(str);
+    }
+
+    inline uint64_t hashPointer(const void* ptr)
+    {
+        return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr));
+    }
+
+    void hashModes(uint64_t& hash, const osg::StateSet::ModeList& modes)
+    {
+        hashCombine(hash, modes.size());
+        for (auto& [mode, value] : modes)
+        {
+            hashCombine(hash, mode);
+            hashCombine(hash, static_cast<uint64_t>(value));
+        }
+    }
+
+    void hashAttributes(uint64_t& hash, const osg::StateSet::AttributeList& attributes)
+    {
+        hashCombine(hash, attributes.size());
+        for (auto& [typeMember, attributePair] : attributes)
+        {
+            hashCombine(hash, typeMember.first);
+            hashCombine(hash, typeMember.second);
+            hashCombine(hash, hashPointer(attributePair.first.get()));
+            hashCombine(hash, static_cast<uint64_t>(attributePair.second));
+        }
+    }
+}
+
+uint64_t osg2vsg::hashStateSet(const osg::StateSet& stateset)
+{
+    uint64_t hash = 0;
+
+    hashModes(hash, stateset.getModeList());
+    hashAttributes(hash, stateset.getAttributeList());
+
+    hashCombine(hash, stateset.getTextureModeList().size());
+    for (auto& modes : stateset.getTextureModeList()) hashModes(hash, modes);
+
+    hashCombine(hash, stateset.getTextureAttributeList().size());
+    for (auto& attributes : stateset.getTextureAttributeList()) hashAttributes(hash, attributes);
+
+    hashCombine(hash, stateset.getUniformList().size());
+    for (auto& [name, uniformPair] : stateset.getUniformList())
+    {
+        hashCombine(hash, hashString(name));
+        hashCombine(hash, hashPointer(uniformPair.first.get()));
+        hashCombine(hash, static_cast<uint64_t>(uniformPair.second));
+    }
+
+    hashCombine(hash, stateset.getDefineList().size());
+    for (auto& [name, definePair] : stateset.getDefineList())
+    {
+        hashCombine(hash, hashString(name));
+        hashCombine(hash, hashString(definePair.first));
+        hashCombine(hash, static_cast<uint64_t>(definePair.second));
+    }
+
+    return hash;
+}
+
+size_t UniqueStateSets::findSlot(const osg::StateSet* stateset, uint64_t hash) const
+{
+    // linear probing, the capacity is a power of two and never more than half full so there is always an empty slot
+    size_t mask = _slots.size() - 1;
+    for (size_t index = hash & mask;; index = (index + 1) & mask)
+    {
+        auto& slot = _slots[index];
+        if (!slot.stateset) return index;
+        if (slot.hash == hash && slot.stateset->compare(*stateset) == 0) return index;
+    }
+}
+
+osg::StateSet* UniqueStateSets::find(const osg::StateSet* stateset) const
+{
+    if (!stateset || _size == 0) return nullptr;
+
+    return _slots[findSlot(stateset, hash(stateset))].stateset.get();
+}
+
+osg::ref_ptr<osg::StateSet> UniqueStateSets::insert(osg::ref_ptr<osg::StateSet> stateset)
+{
+    if (!stateset) return stateset;
+
+    if ((_size + 1) * 2 > _slots.size()) rehash(std::max(_slots.size() * 2, size_t(64)));
+
+    uint64_t stateSetHash = hash(stateset.get());
+    auto& slot = _slots[findSlot(stateset.get(), stateSetHash)];
+    if (slot.stateset) return slot.stateset;
+
+    slot.hash = stateSetHash;
+    slot.stateset = stateset;
+    ++_size;
+
+    // only the inserted StateSets are cached, so temporaries that are looked up don't accumulate
+    _hashes[stateset.get()] = stateSetHash;
+    return stateset;
+}
+
+uint64_t UniqueStateSets::hash(const osg::StateSet* stateset) const
+{
+    if (auto itr = _hashes.find(stateset); itr != _hashes.end()) return itr->second;
+    return hashStateSet(*stateset);
+}
+
+void UniqueStateSets::clear()
+{
+    _slots.clear();
+    _size = 0;
+    _hashes.clear();
+}
+
+void UniqueStateSets::rehash(size_t capacity)
+{
+    // the hashes are kept in the slots so the StateSets don't need rehashing
+    std::vector<Slot> slots(capacity);
+    slots.swap(_slots);
+
+    size_t mask = _slots.size() - 1;
+    for (auto& slot : slots)
+    {
+        if (!slot.stateset) continue;
+
+        size_t index = slot.hash & mask;
+        while (_slots[index].stateset) index = (index + 1) & mask;
+        _slots[index] = std::move(slot);
+    }
+}
@@ -0,0 +1,51 @@
+#include <osg2vsg/ThreadingUtils.h>
+
+#include <thread>
+#include <vector>
+
+using namespace osg2vsg;
+
+namespace
+{
+    struct SharedOperationThreads
+    {
+        std::mutex mutex;
+        uint32_t numThreads = 0;
+        vsg::ref_ptr<vsg::Active> active;
+        vsg::ref_ptr<vsg::OperationThreads> operationThreads;
+
+        // pools replaced by larger ones, kept running as parallelFor calls in progress may still have operations queued on them
+        std::vector<std::pair<vsg::ref_ptr<vsg::Active>, vsg::ref_ptr<vsg::OperationThreads>>> retired;
+
+        ~SharedOperationThreads()
+        {
+            // signal the threads to close before they are joined
+            if (active) active->active = false;
+            for(auto& [retiredActive, retiredOperationThreads] : retired) retiredActive->active = false;
+            operationThreads = {};
+            retired.clear();
+        }
+    };
+}
+
+vsg::ref_ptr<vsg::OperationThreads> osg2vsg::getSharedOperationThreads(uint32_t minNumThreads)
+{
+    static SharedOperationThreads s_shared;
+
+    std::lock_guard<std::mutex> guard(s_shared.mutex);
+    if (!s_shared.operationThreads || s_shared.numThreads < minNumThreads)
+    {
+        if (s_shared.operationThreads) s_shared.retired.emplace_back(s_shared.active, s_shared.operationThreads);
+
+        s_shared.numThreads = std::max(minNumThreads, static_cast<uint32_t>(std::thread::hardware_concurrency()));
+        s_shared.active = vsg::Active::create();
+        s_shared.operationThreads = vsg::OperationThreads::create(s_shared.numThreads, s_shared.active);
+    }
+    return s_shared.operationThreads;
+}
+
+bool& osg2vsg::insideParallelFor()
+{
+    thread_local bool s_insideParallelFor = false;
+    return s_insideParallelFor;
+}
@@ -1,6 +1,28 @@
 char fbxshader_frag[] = "#version 450\n"
-                        "#pragma import_defines ( VSG_NORMAL, VSG_COLOR, VSG_TEXCOORD0, VSG_LIGHTING, VSG_MATERIAL, VSG_DIFFUSE_MAP, VSG_OPACITY_MAP, VSG_AMBIENT_MAP, VSG_NORMAL_MAP, VSG_SPECULAR_MAP )\n"
+                        "#pragma import_defines ( VSG_NORMAL, VSG_COLOR, VSG_TEXCOORD0, VSG_LIGHTING, VSG_MATERIAL, VSG_DIFFUSE_MAP, VSG_OPACITY_MAP, VSG_AMBIENT_MAP, VSG_NORMAL_MAP, VSG_SPECULAR_MAP, VSG_MATERIAL_BUFFER, VSG_BINDLESS_TEXTURES )\n"
                         "#extension GL_ARB_separate_shader_objects : enable\n"
+                        "#if defined(VSG_MATERIAL_BUFFER) || defined(VSG_BINDLESS_TEXTURES)\n"
+                        "layout(push_constant) uniform FragmentPushConstants\n"
+                        "{\n"
+                        "    layout(offset = 128) uint materialIndex;\n"
+                        "#ifdef VSG_BINDLESS_TEXTURES\n"
+                        "    uint diffuseIndex;\n"
+                        "    uint opacityIndex;\n"
+                        "    uint ambientIndex;\n"
+                        "    uint normalIndex;\n"
+                        "    uint specularIndex;\n"
+                        "#endif\n"
+                        "} fpc;\n"
+                        "#endif\n"
+                        "#ifdef VSG_BINDLESS_TEXTURES\n"
+                        "layout(constant_id = 0) const uint maxBindlessTextures = 16;\n"
+                        "layout(binding = 11) uniform sampler2D textures[maxBindlessTextures];\n"
+                        "#define diffuseMap textures[fpc.diffuseIndex]\n"
+                        "#define opacityMap textures[fpc.opacityIndex]\n"
+                        "#define ambientMap textures[fpc.ambientIndex]\n"
+                        "#define normalMap textures[fpc.normalIndex]\n"
+                        "#define specularMap textures[fpc.specularIndex]\n"
+                        "#else\n"
                         "#ifdef VSG_DIFFUSE_MAP\n"
                         "layout(binding = 0) uniform sampler2D diffuseMap;\n"
                         "#endif\n"
@@ -16,8 +38,23 @@ char fbxshader_frag[] = "#version 450\n"
                         "#ifdef VSG_SPECULAR_MAP\n"
                         "layout(binding = 6) uniform sampler2D specularMap;\n"
                         "#endif\n"
+                        "#endif\n"
                         "\n"
                         "#ifdef VSG_MATERIAL\n"
+                        "#ifdef VSG_MATERIAL_BUFFER\n"
+                        "struct MaterialData\n"
+                        "{\n"
+                        "    vec4 ambientColor;\n"
+                        "    vec4 diffuseColor;\n"
+                        "    vec4 specularColor;\n"
+                        "    float shine;\n"
+                        "};\n"
+                        "layout(std430, binding = 10) readonly buffer Materials\n"
+                        "{\n"
+                        "    MaterialData materials[];\n"
+                        "};\n"
+                        "#define material materials[fpc.materialIndex]\n"
+                        "#else\n"
                         "layout(binding = 10) uniform MaterialData\n"
                         "{\n"
                         "    vec4 ambientColor;\n"
@@ -26,6 +63,7 @@ char fbxshader_frag[] = "#version 450\n"
                         "    float shine;\n"
                         "} material;\n"
                         "#endif\n"
+                        "#endif\n"
                         "\n"
                         "#ifdef VSG_NORMAL\n"
                         "layout(location = 1) in vec3 normalDir;\n"
@@ -0,0 +1,103 @@
+char fbxshader_uber_frag[] = "#version 450\n"
+                             "#pragma import_defines ( VSG_NORMAL, VSG_COLOR, VSG_TEXCOORD0 )\n"
+                             "#extension GL_ARB_separate_shader_objects : enable\n"
+                             "\n"
+                             "// shading features are specialization constants so one module serves all the shaderModeMask combinations\n"
+                             "layout(constant_id = 0) const bool lighting = false;\n"
+                             "layout(constant_id = 1) const bool materialEnabled = false;\n"
+                             "layout(constant_id = 2) const bool diffuseMapping = false;\n"
+                             "layout(constant_id = 3) const bool opacityMapping = false;\n"
+                             "layout(constant_id = 4) const bool ambientMapping = false;\n"
+                             "layout(constant_id = 5) const bool normalMapping = false;\n"
+                             "layout(constant_id = 6) const bool specularMapping = false;\n"
+                             "\n"
+                             "// all the samplers and the material are always bound so every variant shares the same descriptor set layout\n"
+                             "layout(binding = 0) uniform sampler2D diffuseMap;\n"
+                             "layout(binding = 1) uniform sampler2D opacityMap;\n"
+                             "layout(binding = 4) uniform sampler2D ambientMap;\n"
+                             "layout(binding = 5) uniform sampler2D normalMap;\n"
+                             "layout(binding = 6) uniform sampler2D specularMap;\n"
+                             "\n"
+                             "layout(binding = 10) uniform MaterialData\n"
+                             "{\n"
+                             "    vec4 ambientColor;\n"
+                             "    vec4 diffuseColor;\n"
+                             "    vec4 specularColor;\n"
+                             "    float shine;\n"
+                             "} material;\n"
+                             "\n"
+                             "#ifdef VSG_NORMAL\n"
+                             "layout(location = 1) in vec3 normalDir;\n"
+                             "layout(location = 5) in vec3 viewDir;\n"
+                             "layout(location = 6) in vec3 lightDir;\n"
+                             "#endif\n"
+                             "#ifdef VSG_COLOR\n"
+                             "layout(location = 3) in vec4 vertColor;\n"
+                             "#endif\n"
+                             "#ifdef VSG_TEXCOORD0\n"
+                             "layout(location = 4) in vec2 texCoord0;\n"
+                             "#endif\n"
+                             "layout(location = 0) out vec4 outColor;\n"
+                             "\n"
+                             "void main()\n"
+                             "{\n"
+                             "    vec4 base = vec4(1.0,1.0,1.0,1.0);\n"
+                             "#ifdef VSG_TEXCOORD0\n"
+                             "    if (diffuseMapping) base = texture(diffuseMap, texCoord0.st);\n"
+                             "#endif\n"
+                             "#ifdef VSG_COLOR\n"
+                             "    base = base * vertColor;\n"
+                             "#endif\n"
+                             "    vec3 ambientColor = vec3(0.1,0.1,0.1);\n"
+                             "    vec3 diffuseColor = vec3(1.0,1.0,1.0);\n"
+                             "    vec3 specularColor = vec3(0.3,0.3,0.3);\n"
+                             "    float shine = 16.0;\n"
+                             "    if (materialEnabled)\n"
+                             "    {\n"
+                             "        ambientColor = material.ambientColor.rgb;\n"
+                             "        diffuseColor = material.diffuseColor.rgb;\n"
+                             "        specularColor = material.specularColor.rgb;\n"
+                             "        shine = material.shine;\n"
+                             "    }\n"
+                             "#ifdef VSG_TEXCOORD0\n"
+                             "    if (ambientMapping) ambientColor *= texture(ambientMap, texCoord0.st).r;\n"
+                             "    if (specularMapping) specularColor = texture(specularMap, texCoord0.st).rrr;\n"
+                             "#endif\n"
+                             "    vec4 color = base;\n"
+                             "    color.rgb *= diffuseColor;\n"
+                             "#ifdef VSG_NORMAL\n"
+                             "    if (lighting)\n"
+                             "    {\n"
+                             "        vec3 nDir = normalDir;\n"
+                             "#ifdef VSG_TEXCOORD0\n"
+                             "        if (normalMapping)\n"
+                             "        {\n"
+                             "            nDir = texture(normalMap, texCoord0.st).xyz*2.0 - 1.0;\n"
+                             "            nDir.g = -nDir.g;\n"
+                             "        }\n"
+                             "#endif\n"
+                             "        vec3 nd = normalize(nDir);\n"
+                             "        vec3 ld = normalize(lightDir);\n"
+                             "        vec3 vd = normalize(viewDir);\n"
+                             "        color = vec4(0.01, 0.01, 0.01, 1.0);\n"
+                             "        color.rgb += ambientColor;\n"
+                             "        float diff = max(dot(ld, nd), 0.0);\n"
+                             "        color.rgb += diffuseColor * diff;\n"
+                             "        color *= base;\n"
+                             "        if (diff > 0.0)\n"
+                             "        {\n"
+                             "            vec3 halfDir = normalize(ld + vd);\n"
+                             "            color.rgb += base.a * specularColor *\n"
+                             "                pow(max(dot(halfDir, nd), 0.0), shine);\n"
+                             "        }\n"
+                             "    }\n"
+                             "#endif\n"
+                             "    outColor = color;\n"
+                             "#ifdef VSG_TEXCOORD0\n"
+                             "    if (opacityMapping) outColor.a *= texture(opacityMap, texCoord0.st).r;\n"
+                             "#endif\n"
+                             "\n"
+                             "    // crude version of AlphaFunc\n"
+                             "    if (outColor.a==0.0) discard;\n"
+                             "}\n"
+                             "\n";
@@ -0,0 +1,133 @@
+// Build time tool that enumerates the ShaderModeMask x GeometryAttributes permutations of the built in shaders,
+// compiles them to SPIR-V and writes them out as a sorted table that is compiled into the osg2vsg library.
+
+#include <osg2vsg/ShaderUtils.h>
+#include <osg2vsg/GeometryUtils.h>
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+using namespace osg2vsg;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " PrecompiledShaders.cpp" << std::endl;
+        return 1;
+    }
+
+    // only the bits that inject defines need to be enumerated, BLEND and the OVERALL bindings only affect pipeline state
+    const uint32_t shaderModeBits[] = { LIGHTING, MATERIAL, BILLBOARD, DIFFUSE_MAP, OPACITY_MAP, AMBIENT_MAP, NORMAL_MAP, SPECULAR_MAP, SHADER_TRANSLATE, MATERIAL_STORAGE_BUFFER, BINDLESS_TEXTURES };
+    const uint32_t geometryBits[] = { NORMAL, TANGENT, COLOR, TEXCOORD0 };
+
+    const uint32_t numShaderModeBits = sizeof(shaderModeBits) / sizeof(shaderModeBits[0]);
+    const uint32_t numGeometryBits = sizeof(geometryBits) / sizeof(geometryBits[0]);
+
+    using CreateSource = std::string (*)(const uint32_t&, const uint32_t&);
+    struct ShaderSource
+    {
+        VkShaderStageFlagBits stage;
+        CreateSource createSource;
+    };
+
+    const ShaderSource shaderSources[] = {
+        { VK_SHADER_STAGE_VERTEX_BIT, createFbxVertexSource },
+        { VK_SHADER_STAGE_FRAGMENT_BIT, createFbxFragmentSource },
+        { VK_SHADER_STAGE_VERTEX_BIT, createDefaultVertexSource },
+        { VK_SHADER_STAGE_FRAGMENT_BIT, createDefaultFragmentSource },
+        { VK_SHADER_STAGE_VERTEX_BIT, [](const uint32_t&, const uint32_t& geometryAttributes) { return createFbxUberVertexSource(geometryAttributes); } },
+        { VK_SHADER_STAGE_FRAGMENT_BIT, [](const uint32_t&, const uint32_t& geometryAttributes) { return createFbxUberFragmentSource(geometryAttributes); } }
+    };
+
+    // collect the unique sources, many permutations map to the same source as each shader only imports the defines it uses
+    using StageSource = std::pair<VkShaderStageFlagBits, std::string>;
+    std::map<uint64_t, StageSource> sources;
+
+    for (uint32_t s = 0; s < (1u << numShaderModeBits); ++s)
+    {
+        uint32_t shaderModeMask = 0;
+        for (uint32_t b = 0; b < numShaderModeBits; ++b)
+        {
+            if (s & (1u << b)) shaderModeMask |= shaderModeBits[b];
+        }
+
+        for (uint32_t g = 0; g < (1u << numGeometryBits); ++g)
+        {
+            uint32_t geometryAttributes = VERTEX;
+            for (uint32_t b = 0; b < numGeometryBits; ++b)
+            {
+                if (g & (1u << b)) geometryAttributes |= geometryBits[b];
+            }
+
+            for (auto& shaderSource : shaderSources)
+            {
+                auto source = shaderSource.createSource(shaderModeMask, geometryAttributes);
+                auto key = hashShaderSource(shaderSource.stage, source);
+
+                auto [itr, inserted] = sources.emplace(key, StageSource(shaderSource.stage, source));
+                if (!inserted && (itr->second.first != shaderSource.stage || itr->second.second != source))
+                {
+                    std::cerr << "precompile_shaders: hash collision for shaderModeMask=" << shaderModeMask << ", geometryAttributes=" << geometryAttributes << std::endl;
+                    return 1;
+                }
+            }
+        }
+    }
+
+    std::cout << "precompile_shaders: compiling " << sources.size() << " unique shaders" << std::endl;
+
+    auto shaderCompiler = ShaderCompiler::create();
+    shaderCompiler->shaderCache = nullptr; // always compile from source
+
+    std::map<uint64_t, vsg::ShaderModule::SPIRV> compiled;
+    for (auto& [key, stageSource] : sources)
+    {
+        vsg::ShaderStages stages{ vsg::ShaderStage::create(stageSource.first, "main", stageSource.second) };
+        if (!shaderCompiler->compile(stages))
+        {
+            std::cerr << "precompile_shaders: failed to compile shader" << std::endl;
+            return 1;
+        }
+        compiled[key] = stages.front()->getShaderModule()->spirv();
+    }
+
+    std::ofstream fout(argv[1]);
+    if (!fout)
+    {
+        std::cerr << "precompile_shaders: could not open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    fout << "// generated by precompile_shaders, do not edit\n\n";
+    fout << "#include \"PrecompiledShaders.h\"\n\n";
+    fout << "namespace osg2vsg::precompiled\n{\n";
+
+    // std::map iterates in key order so the entries are sorted as required by getPrecompiledSPIRV(..)
+    fout << "    constexpr Entry entries[] = {\n";
+    uint32_t offset = 0;
+    for (auto& [key, spirv] : compiled)
+    {
+        fout << "        { 0x" << std::hex << std::setw(16) << std::setfill('0') << key << "ull, " << std::dec << offset << ", " << spirv.size() << " },\n";
+        offset += static_cast<uint32_t>(spirv.size());
+    }
+    fout << "    };\n\n";
+
+    fout << "    constexpr uint32_t numEntries = " << compiled.size() << ";\n\n";
+
+    fout << "    constexpr uint32_t words[] = {";
+    uint32_t count = 0;
+    for (auto& [key, spirv] : compiled)
+    {
+        for (auto word : spirv)
+        {
+            if ((count++ % 8) == 0) fout << "\n       ";
+            fout << " 0x" << std::hex << std::setw(8) << std::setfill('0') << word << ",";
+        }
+    }
+    fout << std::dec << "\n    };\n}\n";
+
+    return fout.good() ? 0 : 1;
+}
@@ -29,6 +29,9 @@ class ReaderWriterVSG : public osgDB::ReaderWriter
         {
             supportsExtension("vsga","vsg ascii format");
             supportsExtension("vsgb","vsg binary format");
+
+            // share the BuildOptions, and with it the PipelineCache, across writeNode() calls so compiled shaders are reused
+            _buildOptions = osg2vsg::BuildOptions::create();
         }
 
         virtual const char* className() const { return "VSG Reader/Writer"; }
@@ -127,7 +130,7 @@ class ReaderWriterVSG : public osgDB::ReaderWriter
 
 
             // Collect stats about the loaded scene
-            osg2vsg::SceneBuilder sceneAnalysis;
+            osg2vsg::SceneBuilder sceneAnalysis(_buildOptions);
             sceneAnalysis.writeToFileProgramAndDataSetSets = writeToFileProgramAndDataSetSets;
             osg_scene.accept(sceneAnalysis);
 
@@ -142,6 +145,9 @@ class ReaderWriterVSG : public osgDB::ReaderWriter
 
         }
 
+    protected:
+
+        vsg::ref_ptr<osg2vsg::BuildOptions> _buildOptions;
 };
 
 // now register with Registry to instantiate the above